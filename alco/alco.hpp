@@ -101,8 +101,19 @@ struct emessages : noncopyable
     message ms[pre_alloc];
     uint32_t m_s;
 
-    emessages(const std::string& push) : e(push), m_s()
+    //coalescing messages from several frames: send_messages() exports batch only when it
+    //reaches coalesce_size or first message in it older than coalesce_time,
+    //owner should call flush() after every poll iteration, 0 coalesce_size disables mode
+    uint32_t coalesce_size;
+    uint64_t coalesce_time;
+
+    emessages(const std::string& push) : e(push), m_s(), coalesce_size(), coalesce_time()
+    {
+    }
+    void set_coalesce(uint32_t size, uint32_t us)
     {
+        coalesce_size = std::min(size, pre_alloc);
+        coalesce_time = uint64_t(us) * (ttime_t::frac / 1000000);
     }
     void ping(ttime_t etime, ttime_t time)
     {
@@ -117,7 +128,7 @@ struct emessages : noncopyable
     void add_clean(uint32_t security_id, ttime_t etime, ttime_t time)
     {
         if(unlikely(m_s == pre_alloc))
-            send_messages();
+            flush();
         
         message_clean& c = ms[m_s++].mc;
         c.time = time;
@@ -129,7 +140,7 @@ struct emessages : noncopyable
     void add_order(uint32_t security_id, int64_t level_id, price_t price, count_t count, ttime_t etime, ttime_t time)
     {
         if(unlikely(m_s == pre_alloc))
-            send_messages();
+            flush();
 
         message_book& m = ms[m_s++].mb;
         m.time = time;
@@ -143,7 +154,7 @@ struct emessages : noncopyable
     void add_trade(uint32_t security_id, price_t price, count_t count, uint32_t direction, ttime_t etime, ttime_t time)
     {
         if(unlikely(m_s == pre_alloc))
-            send_messages();
+            flush();
 
         message_trade& m = ms[m_s++].mt;
         m.time = time;
@@ -154,7 +165,7 @@ struct emessages : noncopyable
         m.price = price;
         m.count = count;
     }
-    void send_messages()
+    void flush()
     {
         if(m_s) {
             set_export_mtime(ms);
@@ -162,5 +173,11 @@ struct emessages : noncopyable
             m_s = 0;
         }
     }
+    void send_messages()
+    {
+        if(m_s && (likely(!coalesce_size) || m_s >= coalesce_size
+            || get_cur_ttime().value - ms[0].t.time.value >= coalesce_time))
+            flush();
+    }
 };
 
@@ -0,0 +1,49 @@
+/*
+    offline parsers benchmark, replays lws_dump recording mapped to memory through lws_i::proceed()
+    with counting allocations, usage:
+        lws_fake=binance.dump lws_bench=100 ./binance_bench binance.conf
+
+    author: Ilya Andronov <sni4ok@yandex.ru>
+*/
+
+#pragma once
+
+#include "main.hpp"
+#include "lws.hpp"
+
+#include <new>
+
+void* operator new(size_t size)
+{
+    ++lws_bench_allocs;
+    void* p = malloc(size);
+    if(unlikely(!p))
+        throw std::bad_alloc();
+    return p;
+}
+
+void* operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void operator delete(void* p) noexcept
+{
+    free(p);
+}
+
+void operator delete[](void* p) noexcept
+{
+    free(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+    free(p);
+}
+
+void operator delete[](void* p, size_t) noexcept
+{
+    free(p);
+}
+
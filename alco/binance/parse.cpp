@@ -12,12 +12,12 @@ struct lws_i : sec_id_by_name<lws_impl>
 {
     config& cfg;
     
-    lws_i() : cfg(config::instance())
+    lws_i(const std::vector<std::string>& tickers) : sec_id_by_name(tickers), cfg(config::instance())
     {
         std::stringstream sub;
         sub << "{\"method\":\"SUBSCRIBE\",\"params\":[";
         int i = 0;
-        for(auto& v: cfg.tickers) {
+        for(auto& v: tickers) {
             if(cfg.trades) {
                 if(i++)
                     sub << ",";
@@ -130,6 +130,11 @@ void proceed_binance(volatile bool& can_run)
     return proceed_lws_parser<lws_i>(can_run);
 }
 
+void bench_binance(volatile bool& can_run)
+{
+    return proceed_lws_bench<lws_i>(can_run);
+}
+
 void connect(lws_i& ls)
 {
 	lws_client_connect_info ccinfo = lws_client_connect_info();
@@ -0,0 +1,14 @@
+/*
+   author: Ilya Andronov <sni4ok@yandex.ru>
+*/
+
+#include "config.hpp"
+#include "../bench.hpp"
+
+void bench_bitfinex(volatile bool& can_run);
+
+int main(int argc, char** argv)
+{
+    return parser_main(argc, argv, "bitfinex_bench", bench_bitfinex);
+}
+
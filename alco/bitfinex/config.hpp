@@ -9,6 +9,7 @@
 struct config : stack_singleton<config>
 {
     std::vector<std::string> tickers;
+    uint32_t connections; //tickers sharded by connections, every one parsed in own thread
     bool trades, orders;
 
     std::string precision; //Level of price aggregation (R0, P0, P1, P2, P3, P4)
@@ -18,9 +19,12 @@ struct config : stack_singleton<config>
     uint32_t ping; //bitfinex close connection without auto pings from websocket, this param set force pings
                    //in seconds, 0 for disable
 
+    bool validate_book; //local books with exchange checksums or sequences check, clean and resubscribe on mismatch
+
     std::string exchange_id, feed_id;
     std::string push;
     bool log_lws;
+    uint32_t coalesce, coalesce_us; //messages batch size and deadline for coalescing frames, 0 disables
 
     config(const char* fname);
 };
@@ -26,6 +26,7 @@ struct lws_i : sec_id_by_name<lws_impl>
         uint32_t security_id;
         func f;
         uint32_t high;
+        ticker symbol;
         impl() : high()
         {
         }
@@ -34,17 +35,21 @@ struct lws_i : sec_id_by_name<lws_impl>
     ttime_t ping_t;
 
     fmap<uint32_t, impl> parsers; //channel, impl
-    lws_i() :
+    lws* wsi;
+    lws_i(const std::vector<std::string>& tickers) : sec_id_by_name(tickers),
         cfg(config::instance()),
         subscribed("\"subscribed\",\"channel\":"),
         trade("\"trades\",\"chanId\":"),
         book("\"book\",\"chanId\":"),
         symbol("\"symbol\":\""),
         event("\"event\":"),
-        ping(uint64_t(cfg.ping) * ttime_t::frac), ping_t(get_cur_ttime())
+        ping(uint64_t(cfg.ping) * ttime_t::frac), ping_t(get_cur_ttime()), wsi()
     {
         prec_R0 = (cfg.precision == "R0");
-        for(auto& v: cfg.tickers) {
+        //raw books checksums need order prices for removes, only books by prices validated
+        if(cfg.validate_book && cfg.orders && !prec_R0)
+            subscribes.push_back("{\"event\":\"conf\",\"flags\":131072}"); //OB_CHECKSUM
+        for(auto& v: tickers) {
             if(cfg.trades) {
                 subscribes.push_back("{\"event\":\"subscribe\",\"channel\":\"trades\",\"symbol\":\"" + v + "\"}");
             }
@@ -93,9 +98,68 @@ struct lws_i : sec_id_by_name<lws_impl>
             send_messages();
         }
     }
+    void parse_skip(impl&, ttime_t, iterator& it, iterator ie)
+    {
+        it = ie;
+    }
+    void book_subscribe(const ticker& symbol)
+    {
+        bs << "{\"event\":\"subscribe\",\"channel\":\"book\",\"symbol\":\"" << symbol.str()
+            << "\",\"prec\":\"" << cfg.precision << "\",\"freq\":\"" << cfg.frequency << "\",\"len\":\"" << cfg.length << "\"}";
+        send(wsi);
+    }
+    //top 25 bids and asks interleaved as price:amount, joined by ':'
+    static int32_t book_crc(const local_book& b)
+    {
+        std::vector<const local_book::level*> bids, asks;
+        b.top_bids(25, [&bids](const local_book::level& l) {bids.push_back(&l);});
+        b.top_asks(25, [&asks](const local_book::level& l) {asks.push_back(&l);});
+        crc32 crc(0);
+        bool first = true;
+        auto add = [&crc, &first](const local_book::level* l) {
+            if(!first)
+                crc.process_bytes(":", 1);
+            first = false;
+            crc.process_bytes(l->price.begin(), l->price.size());
+            crc.process_bytes(":", 1);
+            crc.process_bytes(l->amount.begin(), l->amount.size());
+        };
+        for(uint32_t i = 0; i != 25; ++i) {
+            if(i < bids.size())
+                add(bids[i]);
+            if(i < asks.size())
+                add(asks[i]);
+        }
+        return int32_t(crc.checksum());
+    }
+    void check_book(uint32_t channel, impl& i, int32_t checksum, ttime_t time)
+    {
+        local_book& b = books[i.security_id];
+        if(b.resync || i.f != &lws_i::parse_orders)
+            return;
+        if(unlikely(book_crc(b) != checksum)) {
+            book_mismatch(i.security_id, time, "bitfinex checksum");
+            i.f = &lws_i::parse_skip;
+            bs << "{\"event\":\"unsubscribe\",\"chanId\":" << channel << "}";
+            send(wsi);
+            book_subscribe(i.symbol);
+        }
+    }
     void parse_orders(impl& i, ttime_t time, iterator& it, iterator ie)
     {
         bool one = *(it + 1) != '[';
+        local_book* b = (cfg.validate_book && !prec_R0) ? &books[i.security_id] : nullptr;
+        if(b) {
+            if(!one) {
+                b->clear();
+                b->resync = false;
+            }
+            else if(b->resync) {
+                //updates before new snapshot
+                it = ie;
+                return;
+            }
+        }
 
         if(!one)
             skip_fixed(it, "[");
@@ -120,6 +184,7 @@ struct lws_i : sec_id_by_name<lws_impl>
             }
             else
             {
+                str_holder price_s(it, ne - it);
                 price_t price = read_price(it, ne);
                 ++ne;
                 it = std::find(ne, ie, ',');
@@ -131,6 +196,13 @@ struct lws_i : sec_id_by_name<lws_impl>
                     add_order(i.security_id, price.value, price, amount, ttime_t(), time);
                 else
                     add_order(i.security_id, price.value, price, count_t(), ttime_t(), time);
+                if(b) {
+                    bool ask = amount.value < 0;
+                    if(count > 0)
+                        b->set(ask, {price.value, 0}, price_s, str_holder(it, ne - it));
+                    else
+                        b->erase(ask, {price.value, 0});
+                }
             }
             it = ne + 1;
             if(*it != ',')
@@ -149,6 +221,7 @@ struct lws_i : sec_id_by_name<lws_impl>
         mlog() << "add_channel: " << channel << ", ticker: " << ticker << ", is_trades: " << is_trades;
         impl& i = parsers[channel];
         i.security_id = get_security_id(ticker.str, ticker.str + ticker.size, time);
+        i.symbol = ticker;
         if(is_trades)
             i.f = &lws_i::parse_trades;
         else
@@ -156,6 +229,7 @@ struct lws_i : sec_id_by_name<lws_impl>
     }
     void proceed(lws* wsi, void* in, size_t len)
     {
+        this->wsi = wsi;
         ttime_t time = get_cur_ttime();
         if(cfg.log_lws)
             mlog() << "lws proceed: " << str_holder((const char*)in, len);
@@ -167,6 +241,12 @@ struct lws_i : sec_id_by_name<lws_impl>
             iterator ne = std::find(it, ie, ',');
             uint32_t channel = my_cvt::atoi<uint32_t>(it, ne - it);
             skip_fixed(ne, ",");
+            if(unlikely(skip_if_fixed(ne, "\"cs\","))) {
+                it = std::find(ne, ie, ']');
+                if(cfg.validate_book)
+                    check_book(channel, parsers.at(channel), my_cvt::atoi<int32_t>(ne, it - ne), time);
+                return;
+            }
             ne = std::find(ne, ie, '[');
 
             if(likely(ne != ie)) {
@@ -226,6 +306,11 @@ void proceed_bitfinex(volatile bool& can_run)
     return proceed_lws_parser<lws_i>(can_run);
 }
 
+void bench_bitfinex(volatile bool& can_run)
+{
+    return proceed_lws_bench<lws_i>(can_run);
+}
+
 void connect(lws_i& ls)
 {
 	lws_client_connect_info ccinfo =lws_client_connect_info();
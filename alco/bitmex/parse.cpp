@@ -14,13 +14,13 @@ struct lws_i : sec_id_by_name<lws_impl>, read_time_impl
 
     str_holder orders_table, trades_table;
 
-    lws_i() : cfg(config::instance()), orders_table(cfg.orders_table.c_str(), cfg.orders_table.size()),
-    trades_table("trade")
+    lws_i(const std::vector<std::string>& tickers) : sec_id_by_name(tickers), cfg(config::instance()),
+    orders_table(cfg.orders_table.c_str(), cfg.orders_table.size()), trades_table("trade")
     {
         std::string sb = "{\"op\":\"subscribe\",\"args\":\"";
         std::string se = "\"}";
 
-        for(auto& v: cfg.tickers) {
+        for(auto& v: tickers) {
             if(cfg.orders)
                 subscribes.push_back(sb + cfg.orders_table + ":" + v + se);
             if(cfg.trades)
@@ -52,6 +52,43 @@ struct lws_i : sec_id_by_name<lws_impl>, read_time_impl
         skip_fixed(it, "]");
     }
 
+    std::vector<uint32_t> partials;
+    //levels of orderBookL2 by id: partial replaces book, insert adds new level, update and delete need existing one
+    bool check_level(lws* wsi, str_holder action, uint32_t security_id, str_holder symbol, uint64_t id, bool ask, ttime_t time)
+    {
+        local_book& b = books[security_id];
+        local_book::key k(id, 0);
+        if(action == "partial") {
+            if(std::find(partials.begin(), partials.end(), security_id) == partials.end()) {
+                partials.push_back(security_id);
+                b.clear();
+                b.resync = false;
+            }
+            b.set(ask, k, str_holder("", 0), str_holder("", 0));
+            return true;
+        }
+        if(b.resync)
+            return false;
+        bool ok = true;
+        if(action == "insert") {
+            ok = !b.has(ask, k);
+            if(ok)
+                b.set(ask, k, str_holder("", 0), str_holder("", 0));
+        }
+        else if(action == "update")
+            ok = b.has(ask, k);
+        else if(action == "delete")
+            ok = b.erase(ask, k);
+        if(unlikely(!ok)) {
+            book_mismatch(security_id, time, _str_holder(es() % "bitmex " % action % " for level " % id));
+            bs << "{\"op\":\"unsubscribe\",\"args\":\"" << cfg.orders_table << ":" << symbol << "\"}";
+            send(wsi);
+            bs << "{\"op\":\"subscribe\",\"args\":\"" << cfg.orders_table << ":" << symbol << "\"}";
+            send(wsi);
+        }
+        return ok;
+    }
+
     ttime_t etime = ttime_t();
     void proceed(lws* wsi, void* in, size_t len)
     {
@@ -68,6 +105,8 @@ struct lws_i : sec_id_by_name<lws_impl>, read_time_impl
             it = ne;
             if(table == orders_table)
             {
+                str_holder action = read_named_value("\",\"action\":\"", it, ie, '\"', read_str);
+                partials.clear();
                 search_and_skip_fixed(it, ie, "data\":[");
                 skip_fixed(it, "{");
                 for(;;)
@@ -75,6 +114,7 @@ struct lws_i : sec_id_by_name<lws_impl>, read_time_impl
                     skip_fixed(it, "\"symbol\":\"");
                     ne = std::find(it, ie, '\"');
                     uint32_t security_id = get_security_id(it, ne, time);
+                    str_holder symbol(it, ne - it);
                     it = ne + 1;
                     skip_fixed(it, ",\"");
 
@@ -109,7 +149,8 @@ struct lws_i : sec_id_by_name<lws_impl>, read_time_impl
                             it = ne;
                         }
                         skip_fixed(it, "}");
-                        add_order(security_id, id, p, c, ttime_t(), time);
+                        if(!cfg.validate_book || check_level(wsi, action, security_id, symbol, id, ask, time))
+                            add_order(security_id, id, p, c, ttime_t(), time);
                         if(skip_if_fixed(it, "]}"))
                             break;
                         skip_fixed(it, ",{");
@@ -219,6 +260,11 @@ void proceed_bitmex(volatile bool& can_run)
     return proceed_lws_parser<lws_i>(can_run);
 }
 
+void bench_bitmex(volatile bool& can_run)
+{
+    return proceed_lws_bench<lws_i>(can_run);
+}
+
 void connect(lws_i& ls)
 {
 	lws_client_connect_info ccinfo = lws_client_connect_info();
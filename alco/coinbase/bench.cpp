@@ -0,0 +1,14 @@
+/*
+   author: Ilya Andronov <sni4ok@yandex.ru>
+*/
+
+#include "config.hpp"
+#include "../bench.hpp"
+
+void bench_coinbase(volatile bool& can_run);
+
+int main(int argc, char** argv)
+{
+    return parser_main(argc, argv, "coinbase_bench", bench_coinbase);
+}
+
@@ -9,11 +9,13 @@
 struct config : stack_singleton<config>
 {
     std::vector<std::string> tickers;
+    uint32_t connections; //tickers sharded by connections, every one parsed in own thread
     bool trades, orders;
 
     std::string exchange_id, feed_id;
     std::string push;
     bool log_lws;
+    uint32_t coalesce, coalesce_us; //messages batch size and deadline for coalescing frames, 0 disables
 
     config(const char* fname);
 };
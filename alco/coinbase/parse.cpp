@@ -8,35 +8,20 @@
 #include "../lws.hpp"
 #include "../utils.hpp"
 
-struct lws_i : lws_impl, read_time_impl
+struct lws_i : sec_id_by_name<lws_impl>, read_time_impl
 {
     config& cfg;
-    typedef my_basic_string<char, sizeof(message_instr::security) + 1> ticker;
-    fmap<ticker, security> securities;
 
-    security& get_security(iterator i, iterator ie, ttime_t time)
+    lws_i(const std::vector<std::string>& tickers) : sec_id_by_name(tickers), cfg(config::instance())
     {
-        ticker symbol(i, ie);
-        auto it = securities.find(symbol);
-        if(unlikely(it == securities.end())) {
-            security& s = securities[symbol];
-            s.init(cfg.exchange_id, cfg.feed_id, std::string(i, ie));
-            s.proceed_instr(e, time);
-            return s;
-        }
-        else
-            return it->second;
-    }
-    lws_i() : cfg(config::instance())
-    {
-        std::string tickers = join_tickers(cfg.tickers);
+        std::string products = join_tickers(tickers);
         std::stringstream sub;
-        sub << "{\"type\":\"subscribe\",\"product_ids\": [" << tickers << "],\"channels\": [";
+        sub << "{\"type\":\"subscribe\",\"product_ids\": [" << products << "],\"channels\": [";
         if(cfg.orders)
             sub << "\"level2\",";
         if(cfg.trades)
             sub << "\"matches\",";
-        sub << "{\"name\": \"ticker\",\"product_ids\": [" << tickers << "]}]}";
+        sub << "{\"name\": \"ticker\",\"product_ids\": [" << products << "]}]}";
         subscribes.push_back(sub.str());
     }
     void proceed(lws*, void* in, size_t len)
@@ -49,7 +34,7 @@ struct lws_i : lws_impl, read_time_impl
         if(skip_if_fixed(it, "l2update\",\"product_id\":\""))
         {
             iterator ne = std::find(it, ie, '\"');
-            security& s = get_security(it, ne, time);
+            uint32_t security_id = get_security_id(it, ne, time);
             it = ne + 1;
             skip_fixed(it, ",\"changes\":[[\"");
             bool ask;
@@ -74,7 +59,8 @@ struct lws_i : lws_impl, read_time_impl
             if(unlikely(it != ie))
                 throw std::runtime_error(es() % "parsing message error: " % std::string((iterator)in, ie));
 
-            s.proceed_book(e, p, c, etime, time);
+            add_order(security_id, p.value, p, c, etime, time);
+            send_messages();
         }
         else if(skip_if_fixed(it, "match\",\"trade_id\":"))
         {
@@ -101,7 +87,7 @@ struct lws_i : lws_impl, read_time_impl
             it = ne + 1;
             skip_fixed(it, ",\"product_id\":\"");
             ne = std::find(it, ie, '\"');
-            security& s = get_security(it, ne, time);
+            uint32_t security_id = get_security_id(it, ne, time);
             it = ne + 1;
             skip_fixed(it, ",\"sequence\":");
             it = std::find(it, ie, ',') + 1;
@@ -111,7 +97,8 @@ struct lws_i : lws_impl, read_time_impl
             if(unlikely(it != ie))
                 throw std::runtime_error(es() % "parsing message error: " % std::string((iterator)in, ie));
         
-            s.proceed_trade(e, direction, p, c, etime, time);
+            add_trade(security_id, p, c, direction, etime, time);
+            send_messages();
         }
         else if(skip_if_fixed(it, "heartbeat\""))
         {
@@ -126,6 +113,11 @@ void proceed_coinbase(volatile bool& can_run)
     return proceed_lws_parser<lws_i>(can_run);
 }
 
+void bench_coinbase(volatile bool& can_run)
+{
+    return proceed_lws_bench<lws_i>(can_run);
+}
+
 void connect(lws_i& ls)
 {
 	lws_client_connect_info ccinfo =lws_client_connect_info();
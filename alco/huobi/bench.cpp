@@ -0,0 +1,14 @@
+/*
+   author: Ilya Andronov <sni4ok@yandex.ru>
+*/
+
+#include "config.hpp"
+#include "../bench.hpp"
+
+void bench_huobi(volatile bool& can_run);
+
+int main(int argc, char** argv)
+{
+    return parser_main(argc, argv, "huobi_bench", bench_huobi);
+}
+
@@ -11,6 +11,7 @@ config::config(const char* fname)
     std::string cs = read_file<std::string>(fname);
     std::string smb = get_config_param<std::string>(cs, "tickers");
     tickers = split(smb);
+    connections = std::max<uint32_t>(1, get_config_param<uint32_t>(cs, "connections", true, 1));
     trades = get_config_param<bool>(cs, "trades");
     
     snapshot = get_config_param<bool>(cs, "snapshot");
@@ -27,13 +28,18 @@ config::config(const char* fname)
     if(int(snapshot) + int(orders) + int(bbo) > 1)
         throw std::runtime_error("config::config() snapshot, orders and bbo mutually exclusive");
 
+    validate_book = get_config_param<bool>(cs, "validate_book", true);
     push = get_config_param<std::string>(cs, "push");
     exchange_id = get_config_param<std::string>(cs, "exchange_id");
     feed_id = get_config_param<std::string>(cs, "feed_id");
     log_lws = get_config_param<bool>(cs, "log_lws");
+    coalesce = get_config_param<uint32_t>(cs, "coalesce", true, 0);
+    coalesce_us = get_config_param<uint32_t>(cs, "coalesce_us", true, 20);
 
-    mlog() << "config() tickers: " << smb
+    mlog() << "config() tickers: " << smb << ", connections: " << connections
         << ", trades: " << trades << ", orders: " << orders << ", step: " << step
-        << ",\n    push: " << push << ", log_lws: " << log_lws;
+        << ",\n    push: " << push << ", log_lws: " << log_lws
+        << ", coalesce: " << coalesce << ", coalesce_us: " << coalesce_us
+        << ", validate_book: " << validate_book;
 }
 
@@ -9,13 +9,17 @@
 struct config : stack_singleton<config>
 {
     std::vector<std::string> tickers;
+    uint32_t connections; //tickers sharded by connections, every one parsed in own thread
     bool trades, orders, snapshot, bbo;
     std::string step; //for snapshot, possible values: step0, step1, step2, step3, step4, step5
     std::string levels; //for orders, possible values: 150
     
+    bool validate_book; //local books with exchange checksums or sequences check, clean and resubscribe on mismatch
+
     std::string exchange_id, feed_id;
     std::string push;
     bool log_lws;
+    uint32_t coalesce, coalesce_us; //messages batch size and deadline for coalescing frames, 0 disables
 
     config(const char* fname);
 };
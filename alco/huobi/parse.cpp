@@ -60,7 +60,6 @@ struct lws_i : sec_id_by_name<lws_impl>
     char ping[7];
     char error[16];
 
-    typedef my_basic_string<char, 64> string;
     struct impl;
     typedef void (lws_i::*func)(impl& i, ttime_t etime, ttime_t time, iterator& it, iterator ie);
     struct impl
@@ -75,7 +74,8 @@ struct lws_i : sec_id_by_name<lws_impl>
         uint32_t security_id;
         func f;
     };
-    fmap<string, impl> parsers;
+    perfect_hash<impl, 64> parsers;
+    lws* wsi;
 
     void parse_bbo(impl& i, ttime_t etime, ttime_t time, iterator& it, iterator ie)
     {
@@ -140,8 +140,65 @@ struct lws_i : sec_id_by_name<lws_impl>
         else
             ++it;
     }
+    //mbp refresh, the only snapshot of incremental book, answered by rep message
+    void orders_refresh(const ticker& security)
+    {
+        config& c = config::instance();
+        bs << "{\"req\":\"market." << security.str() << ".mbp." << c.levels
+            << "\",\"id\":\"refresh_" << security.str() << "\"}";
+        send(wsi);
+    }
+    //incremental updates chained by seqNum and prevSeqNum, applied only on top of refresh
+    bool check_seq(impl& i, ttime_t time, iterator& it, iterator ie)
+    {
+        if(!skip_if_fixed(it, "seqNum\":"))
+            return true;
+        iterator ne = std::find(it, ie, ',');
+        uint64_t seq = my_cvt::atoi<uint64_t>(it, ne - it);
+        it = ne;
+        skip_fixed(it, ",\"prevSeqNum\":");
+        ne = std::find(it, ie, ',');
+        uint64_t prev = my_cvt::atoi<uint64_t>(it, ne - it);
+        it = ne;
+        local_book& b = books[i.security_id];
+        if(b.resync)
+            return false;
+        if(unlikely(!b.seq)) {
+            b.resync = true;
+            orders_refresh(i.security);
+            return false;
+        }
+        //updates already contained in refresh
+        if(seq <= b.seq)
+            return false;
+        if(unlikely(b.seq != prev)) {
+            book_mismatch(i.security_id, time, _str_holder(es() % "huobi sequence gap, expected: " % b.seq % ", prev: " % prev));
+            orders_refresh(i.security);
+            return false;
+        }
+        b.seq = seq;
+        return true;
+    }
+    void parse_refresh(impl& i, ttime_t time, iterator& it, iterator ie)
+    {
+        skip_fixed(it, "seqNum\":");
+        iterator ne = std::find(it, ie, ',');
+        uint64_t seq = my_cvt::atoi<uint64_t>(it, ne - it);
+        it = ne;
+        add_clean(i.security_id, ttime_t(), time);
+        parse_orders_impl(i, ttime_t(), time, it, ie);
+        skip_fixed(it, end);
+        local_book& b = books[i.security_id];
+        b.seq = seq;
+        b.resync = false;
+        send_messages();
+    }
     void parse_orders(impl& i, ttime_t etime, ttime_t time, iterator& it, iterator ie)
     {
+        if(config::instance().validate_book && !check_seq(i, time, it, ie)) {
+            it = ie;
+            return;
+        }
         parse_orders_impl(i, etime, time, it, ie);
         skip_fixed(it, end);
         send_messages();
@@ -190,7 +247,7 @@ struct lws_i : sec_id_by_name<lws_impl>
         skip_fixed(it, end);
         send_messages();
     }
-    lws_i() :
+    lws_i(const std::vector<std::string>& tickers) : sec_id_by_name(tickers),
         ch("ch\":\"market."),
         ts(",\"ts\":"),
         tick(",\"tick\":{\""),
@@ -206,30 +263,32 @@ struct lws_i : sec_id_by_name<lws_impl>
         bids("bids\":["),
         asks("asks\":["),
         ping("ping\":"),
-        error("status\":\"error\"")
+        error("status\":\"error\""),
+        wsi()
     {
         config& c = config::instance();
-        for(auto& v: c.tickers) {
+        for(auto& v: tickers) {
             if(c.snapshot) {
-                parsers[v + ".depth." + c.step] = impl(v, &lws_i::parse_snapshot);
+                parsers.insert(v + ".depth." + c.step, impl(v, &lws_i::parse_snapshot));
                 subscribes.push_back("{\"sub\":\"market." + v + ".depth." + c.step + "\",\"id\":\"snapshot_" + v + "\"}");
             }
             if(c.orders) {
-                parsers[v + ".mbp." + c.levels] = impl(v, &lws_i::parse_orders);
+                parsers.insert(v + ".mbp." + c.levels, impl(v, &lws_i::parse_orders));
                 subscribes.push_back("{\"sub\":\"market." + v + ".mbp." + c.levels + "\",\"id\":\"orders_" + v + "\"}");
             }
             if(c.bbo) {
-                parsers[v + ".bbo"] = impl(v, &lws_i::parse_bbo);
+                parsers.insert(v + ".bbo", impl(v, &lws_i::parse_bbo));
                 subscribes.push_back("{\"sub\":\"market." + v + ".bbo\",\"id\":\"bbo_" + v + "\"}");
             }
             if(c.trades) {
-                parsers[v + ".trade.detail"] = impl(v, &lws_i::parse_trades);
+                parsers.insert(v + ".trade.detail", impl(v, &lws_i::parse_trades));
                 subscribes.push_back("{\"sub\":\"market." + v + ".trade.detail\",\"id\":\"trades_" + v + "\"}");
             }
         }
     }
     void proceed(lws* wsi, void* in, size_t len)
     {
+        this->wsi = wsi;
         ttime_t time = get_cur_ttime();
         str_holder str = zlib.decompress(in, len);
         if(config::instance().log_lws)
@@ -244,20 +303,35 @@ struct lws_i : sec_id_by_name<lws_impl>
             it = it + sizeof(ch) - 1;
             iterator ne = std::find(it, ie, '\"');
             str_holder symbol(it, ne - it);
-            auto i = parsers.find(symbol);
-            if(unlikely(i == parsers.end()))
+            impl* i = parsers.find(symbol);
+            if(unlikely(!i))
                 throw std::runtime_error(es() % "unknown symbol in market message: " % str);
-            if(unlikely(!i->second.security_id))
-                i->second.security_id = get_security_id(i->second.security.begin(), i->second.security.end(), time);
+            if(unlikely(!i->security_id))
+                i->security_id = get_security_id(i->security.begin(), i->security.end(), time);
             ++ne;
             skip_fixed(ne, ts);
             ttime_t etime = {my_cvt::atoi<uint64_t>(ne, 13) * (ttime_t::frac / 1000)};
             ne += 13;
             skip_fixed(ne, tick);
-            ((this)->*(i->second.f))(i->second, etime, time, ne, ie);
+            ((this)->*(i->f))(*i, etime, time, ne, ie);
             if(ne != ie)
                 throw std::runtime_error(es() % "parsing market message error: " % str);
         }
+        else if(skip_if_fixed(it, "id\":\"refresh_"))
+        {
+            it = std::find(it, ie, '\"');
+            skip_fixed(it, "\",\"rep\":\"market.");
+            iterator ne = std::find(it, ie, '\"');
+            impl* i = parsers.find(str_holder(it, ne - it));
+            if(unlikely(!i || !i->security_id))
+                throw std::runtime_error(es() % "unknown symbol in refresh message: " % str);
+            it = ne;
+            if(unlikely(!skip_if_fixed(it, "\",\"status\":\"ok\",\"data\":{\"")))
+                throw std::runtime_error(es() % "refresh error: " % str);
+            parse_refresh(*i, time, it, ie);
+            if(it != ie)
+                throw std::runtime_error(es() % "parsing refresh message error: " % str);
+        }
         else if(std::equal(ping, ping + sizeof(ping) - 1, it))
         {
             it = it + sizeof(ping) - 1;
@@ -284,6 +358,11 @@ void proceed_huobi(volatile bool& can_run)
     return proceed_lws_parser<lws_i>(can_run);
 }
 
+void bench_huobi(volatile bool& can_run)
+{
+    return proceed_lws_bench<lws_i>(can_run);
+}
+
 void connect(lws_i& ls)
 {
 	lws_client_connect_info ccinfo = lws_client_connect_info();
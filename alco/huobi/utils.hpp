@@ -1,35 +1,37 @@
 
 #include <zlib.h>
 
-voidpf zlib_alloc_func(voidpf opaque, uInt items, uInt size);
-void zlib_free_func(voidpf, voidpf)
+//one inflate state for all frames, reinitialized by inflateReset()
+struct zlibe : noncopyable
 {
-}
+    static constexpr uint32_t max_presize = 4 * 1024 * 1024, max_size = 64 * 1024 * 1024;
 
-struct zlibe
-{
-    std::vector<char> buf, dest;
-    uint32_t allocated;
+    std::vector<char> dest;
     z_stream strm;
 
-    zlibe() : buf(4 * 1024 * 1024), dest(1024 * 1024), allocated()
+    zlibe() : dest(64 * 1024)
     {
-        strm.zalloc = zlib_alloc_func;
-        strm.zfree = zlib_free_func;
-        strm.opaque = this;
+        memset(&strm, 0, sizeof(strm));
+        if(unlikely(inflateInit2(&strm, MAX_WBITS + 16) != Z_OK))
+            throw std::runtime_error("inflateInit2 error");
     }
-    void* alloc(uInt items, uInt size)
+    ~zlibe()
     {
-        uint32_t req = items * size;
-        if(unlikely(allocated + req > buf.size()))
-            throw std::runtime_error("zlibe::alloc() bad alloc");
-        char* ret = &buf[allocated];
-        allocated += req;
-        return (void*)ret;
+        inflateEnd(&strm);
     }
     str_holder decompress(void* p, uint32_t size)
     {
-        allocated = 0;
+        if(unlikely(inflateReset(&strm) != Z_OK))
+            throw std::runtime_error("inflateReset error");
+
+        //gzip trailer contains uncompressed size, buffer prepared for single inflate() call,
+        //trailer not trusted above max_presize, larger frames grow buffer by loop below
+        if(likely(size > 18)) {
+            uint32_t isize;
+            memcpy(&isize, (char*)p + size - sizeof(isize), sizeof(isize));
+            if(unlikely(isize >= dest.size()))
+                dest.resize(std::min(isize, max_presize) + 1);
+        }
         
         strm.next_in = (Bytef*)p;
         strm.avail_in = size;
@@ -37,20 +39,17 @@ struct zlibe
         strm.next_out = (Bytef*)(&dest[0]);
         strm.avail_out = dest.size();
 
-        int err = inflateInit2(&strm, MAX_WBITS + 16);
-        if(unlikely(err != Z_OK))
-            throw std::runtime_error("inflateInit2 error");
-        
-        err = inflate(&strm, Z_FINISH);
-        if(likely(err == Z_STREAM_END)){
-            return str_holder(&dest[0], strm.total_out);
+        for(;;) {
+            int err = inflate(&strm, Z_FINISH);
+            if(likely(err == Z_STREAM_END))
+                return str_holder(&dest[0], strm.total_out);
+            if(err != Z_BUF_ERROR || strm.avail_out || dest.size() >= max_size)
+                throw std::runtime_error(es() % "zlib::inflate error for size: " % size);
+            uint32_t readed = strm.total_out;
+            dest.resize(std::min<uint64_t>(dest.size() * 2, max_size));
+            strm.next_out = (Bytef*)(&dest[readed]);
+            strm.avail_out = dest.size() - readed;
         }
-        throw std::runtime_error(es() % "zlib::inflate error for size: " % size);
     }
 };
 
-voidpf zlib_alloc_func(voidpf ze, uInt items, uInt size)
-{
-    return ((zlibe*)(ze))->alloc(items, size);
-}
-
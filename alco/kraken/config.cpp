@@ -11,6 +11,7 @@ config::config(const char* fname)
     std::string cs = read_file<std::string>(fname);
     std::string smb = get_config_param<std::string>(cs, "tickers");
     tickers = split(smb);
+    connections = std::max<uint32_t>(1, get_config_param<uint32_t>(cs, "connections", true, 1));
     trades = get_config_param<bool>(cs, "trades");
     orders = get_config_param<bool>(cs, "orders");
     depth = get_config_param<uint32_t>(cs, "depth", true);
@@ -22,14 +23,19 @@ config::config(const char* fname)
     if(orders && bba)
         throw std::runtime_error("config::config() orders and bbo mutually exclusive");
 
+    validate_book = get_config_param<bool>(cs, "validate_book", true);
     push = get_config_param<std::string>(cs, "push");
     exchange_id = get_config_param<std::string>(cs, "exchange_id");
     feed_id = get_config_param<std::string>(cs, "feed_id");
     log_lws = get_config_param<bool>(cs, "log_lws");
+    coalesce = get_config_param<uint32_t>(cs, "coalesce", true, 0);
+    coalesce_us = get_config_param<uint32_t>(cs, "coalesce_us", true, 20);
 
-    mlog() << "config() tickers: " << smb
+    mlog() << "config() tickers: " << smb << ", connections: " << connections
         << ", trades: " << trades << ", orders: " << orders << ", bba: " << bba
         << ", exchange_id: " << exchange_id << ", feed_id: " << feed_id
-        << ",\n    push: " << push << ", log_lws: " << log_lws;
+        << ",\n    push: " << push << ", log_lws: " << log_lws
+        << ", coalesce: " << coalesce << ", coalesce_us: " << coalesce_us
+        << ", validate_book: " << validate_book;
 }
 
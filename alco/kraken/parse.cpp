@@ -22,17 +22,20 @@ struct lws_i : sec_id_by_name<lws_impl>
     config& cfg;
     
     struct impl;
-    typedef void (lws_i::*func)(uint32_t security_id, ttime_t time, iterator& it, iterator ie);
+    typedef void (lws_i::*func)(impl& i, ttime_t time, iterator& it, iterator ie);
     struct impl
     {
         uint32_t security_id;
         func f;
+        ticker pair;
     };
     fmap<uint32_t, impl> parsers; //channel, impl
+    lws* wsi;
 
-    lws_i() : cfg(config::instance())
+    lws_i(const std::vector<std::string>& tickers) : sec_id_by_name(tickers), cfg(config::instance()), wsi(),
+        t_price_s(nullptr, 0), t_count_s(nullptr, 0)
     {
-        std::string s = std::string("{\"event\":\"subscribe\",\"pair\":[") + join_tickers(cfg.tickers) + std::string("],\"subscription\": {");
+        std::string s = std::string("{\"event\":\"subscribe\",\"pair\":[") + join_tickers(tickers) + std::string("],\"subscription\": {");
         if(cfg.orders) {
             std::stringstream sub;
             sub << s;
@@ -50,14 +53,61 @@ struct lws_i : sec_id_by_name<lws_impl>
     price_t t_price;
     count_t t_count;
     ttime_t t_time;
+    str_holder t_price_s, t_count_s;
     void parse_tick(iterator& it, iterator ie)
     {
-        t_price = read_value(it, ie, read_price, false);
-        t_count = read_value(it, ie, read_count, false);
+        t_price = read_value(it, ie, [this](iterator f, iterator t) {
+            t_price_s = str_holder(f, t - f);
+            return read_price(f, t);
+        }, false);
+        t_count = read_value(it, ie, [this](iterator f, iterator t) {
+            t_count_s = str_holder(f, t - f);
+            return read_count(f, t);
+        }, false);
         t_time = read_value(it, ie, read_time, true);
     }
-    void parse_spread(uint32_t security_id, ttime_t time, iterator& it, iterator ie)
+    void parse_skip(impl&, ttime_t, iterator& it, iterator ie)
     {
+        it = ie;
+    }
+    //checksum from top 10 asks and bids, values without decimal point and leading zeros
+    static void crc_add(crc32& crc, const local_book::value& v)
+    {
+        const char* it = std::find_if(v.begin(), v.end(), [](char c) {return c != '0' && c != '.';});
+        for(; it != v.end(); ++it) {
+            if(*it != '.')
+                crc.process_bytes(it, 1);
+        }
+    }
+    static uint32_t book_crc(const local_book& b)
+    {
+        crc32 crc(0);
+        auto f = [&crc](const local_book::level& l) {
+            crc_add(crc, l.price);
+            crc_add(crc, l.amount);
+        };
+        b.top_asks(10, f);
+        b.top_bids(10, f);
+        return crc.checksum();
+    }
+    void book_subscribe(const char* event, const ticker& pair)
+    {
+        bs << "{\"event\":\"" << _str_holder(event) << "\",\"pair\":[\"" << pair.str() << "\"],\"subscription\": {";
+        if(cfg.depth)
+            bs << "\"depth\":" << cfg.depth << ",";
+        bs << "\"name\":\"book\"}}";
+        send(wsi);
+    }
+    void resubscribe(impl& i)
+    {
+        //new subscription comes with new channel id
+        i.f = &lws_i::parse_skip;
+        book_subscribe("unsubscribe", i.pair);
+        book_subscribe("subscribe", i.pair);
+    }
+    void parse_spread(impl& i, ttime_t time, iterator& it, iterator ie)
+    {
+        uint32_t security_id = i.security_id;
         iterator f = it;
         skip_fixed(it, "[");
         price_t bid_price = read_value(it, ie, read_price, false);
@@ -76,9 +126,17 @@ struct lws_i : sec_id_by_name<lws_impl>
        
         send_messages();
     }
-    void parse_book(uint32_t security_id, ttime_t time, iterator& it, iterator ie)
+    void parse_book(impl& i, ttime_t time, iterator& it, iterator ie)
     {
-        bool snapshot = false;
+        uint32_t security_id = i.security_id;
+        local_book* b = cfg.validate_book ? &books[security_id] : nullptr;
+        if(b && b->resync && *(it + 3) != 's') {
+            //updates before new snapshot
+            it = ie;
+            return;
+        }
+        bool snapshot = false, has_crc = false;
+        uint32_t crc = 0;
         iterator f = it;
         skip_fixed(it, "{");
         for(;;){
@@ -92,6 +150,10 @@ struct lws_i : sec_id_by_name<lws_impl>
             ++it;
             if(*it == 's') { //snapshot
                 ++it;
+                if(b && !snapshot) {
+                    b->clear();
+                    b->resync = false;
+                }
                 snapshot = true;
             }
             skip_fixed(it, "\":[");
@@ -107,6 +169,12 @@ struct lws_i : sec_id_by_name<lws_impl>
                     rep = true;
                 }
                 add_order(security_id, t_price.value, t_price, t_count, (snapshot || rep) ? ttime_t() : t_time, time);
+                if(b) {
+                    if(t_count.value)
+                        b->set(ask, {t_price.value, 0}, t_price_s, t_count_s);
+                    else
+                        b->erase(ask, {t_price.value, 0});
+                }
                 skip_fixed(it, "]");
                 if(*it == ',')
                     ++it;
@@ -122,16 +190,29 @@ struct lws_i : sec_id_by_name<lws_impl>
                 continue;
             else
                 throw std::runtime_error(es() % "parsing book message error: " % str_holder(f, ie - f));
-            if(skip_if_fixed(it, " \"c\":\""))
+            if(skip_if_fixed(it, "\"c\":\"") || skip_if_fixed(it, " \"c\":\"")) {
+                iterator ne = std::find(it, ie, '\"');
+                crc = my_cvt::atoi<uint32_t>(it, ne - it);
+                has_crc = true;
+                it = ne;
                 break;
+            }
         }
         if(*(ie - 1) != ']' || ie - it > 35)
             throw std::runtime_error(es() % "parsing book message error: " % str_holder(f, ie - f));
         it = ie;
+        if(b && has_crc) {
+            b->truncate(cfg.depth ? cfg.depth : 10);
+            if(unlikely(book_crc(*b) != crc)) {
+                book_mismatch(security_id, time, "kraken checksum");
+                resubscribe(i);
+            }
+        }
         send_messages();
     }
-    void parse_trade(uint32_t security_id, ttime_t time, iterator& it, iterator ie)
+    void parse_trade(impl& i, ttime_t time, iterator& it, iterator ie)
     {
+        uint32_t security_id = i.security_id;
         iterator f = it;
         skip_fixed(it, "[");
         for(;;)
@@ -165,8 +246,9 @@ struct lws_i : sec_id_by_name<lws_impl>
         it = ie;
         send_messages();
     }
-    void proceed(lws*, void* in, size_t len)
+    void proceed(lws* wsi, void* in, size_t len)
     {
+        this->wsi = wsi;
         ttime_t time = get_cur_ttime();
         if(cfg.log_lws)
             mlog() << "lws proceed: " << str_holder((const char*)in, len);
@@ -179,7 +261,7 @@ struct lws_i : sec_id_by_name<lws_impl>
             uint32_t channel = my_cvt::atoi<uint32_t>(it, ne - it);
             impl& i = parsers.at(channel);
             it = ne + 1;
-            ((this)->*(i.f))(i.security_id, time, it, ie);
+            ((this)->*(i.f))(i, time, it, ie);
         }
         else if(skip_if_fixed(it, "{\"channelID\":"))
         {
@@ -192,6 +274,7 @@ struct lws_i : sec_id_by_name<lws_impl>
             search_and_skip_fixed(it, ie, "\"pair\":\"");
             ne = std::find(it, ie, '\"');
             uint32_t security_id = get_security_id(it, ne, time);
+            ticker pair(it, ne);
             it = ne + 1;
             search_and_skip_fixed(it, ie, "\"name\":\"");
             ne = std::find(it, ie, '\"');
@@ -200,6 +283,7 @@ struct lws_i : sec_id_by_name<lws_impl>
             skip_fixed(it, "}}");
             impl& i = parsers[channel];
             i.security_id = security_id;
+            i.pair = pair;
             if(type == "book")
                 i.f = &lws_i::parse_book;
             else if(type == "trade")
@@ -226,6 +310,11 @@ void proceed_kraken(volatile bool& can_run)
     return proceed_lws_parser<lws_i>(can_run);
 }
 
+void bench_kraken(volatile bool& can_run)
+{
+    return proceed_lws_bench<lws_i>(can_run);
+}
+
 void connect(lws_i& ls)
 {
 	lws_client_connect_info ccinfo =lws_client_connect_info();
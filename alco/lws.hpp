@@ -8,14 +8,45 @@
 
 #include <libwebsockets.h>
 
+#include <thread>
+#include <atomic>
+#include <mutex>
+
 #include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
 #include <fcntl.h>
 
+/*
+    lws_dump file format: file header, then frames, every frame is lws_frame_header and frame data,
+    file mapped to memory for replay, frames index with receive times built on open,
+    old format without file header (frames as '\n', uint32_t size, '\n', data) readed without times
+
+    lws_fake_speed environment variable: 0 (default) replay with max speed,
+    1 replay with original timing, 2 two times faster, etc.
+*/
+
+static const char lws_dump_file_header[] = "\nlws_dump v2   \n";
+
+struct lws_frame_header
+{
+    char delim[4];
+    uint32_t size;
+    ttime_t time;
+};
+
+struct lws_frame
+{
+    ttime_t time;
+    str_holder data;
+};
+
 struct lws_dump
 {
     int hfile;
     bool lws_not_fake, lws_dump_en;
-    lws_dump() : hfile(), lws_not_fake(true), lws_dump_en(), dump_buf("\n    \n")
+    lws_dump() : hfile(), lws_not_fake(true), lws_dump_en(), dump_ptr(), dump_size(), dump_readed(),
+        fake_speed(), replay_from(), dump_from()
     {
         char* dump = getenv("lws_dump");
         char* fake = getenv("lws_fake");
@@ -27,6 +58,7 @@ struct lws_dump
             hfile = ::open(dump, O_WRONLY | O_CREAT | O_APPEND, S_IWRITE | S_IREAD | S_IRGRP | S_IWGRP);
             if(hfile < 0)
                 throw_system_failure(es() % "lws_dump() open file " % _str_holder(dump) % " error");
+            init_dump(dump);
             mlog() << "lws_dump to " << _str_holder(dump) << " enabled";
         }
         if(fake) {
@@ -34,53 +66,128 @@ struct lws_dump
             hfile = ::open(fake, O_RDONLY);
             if(hfile < 0)
                 throw_system_failure(es() % "lws_fake() open file " % _str_holder(fake) % " error");
-            dump_readed = 0;
             struct stat st;
             if(::fstat(hfile, &st))
                 throw_system_failure("fstat() error");
             dump_size = st.st_size;
+            if(dump_size) {
+                //private writable mapping, parsers receive mutable buffers as from lws
+                dump_ptr = (char*)mmap(NULL, dump_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_POPULATE, hfile, 0);
+                if(dump_ptr == MAP_FAILED)
+                    throw_system_failure(es() % "lws_fake() mmap file " % _str_holder(fake) % " error");
+            }
+            read_index();
+            char* speed = getenv("lws_fake_speed");
+            if(speed)
+                fake_speed = lexical_cast<double>(speed);
+            mlog() << "lws_fake frames: " << frames.size() << ", bytes: " << dump_size << ", speed: " << fake_speed;
+        }
+    }
+    void init_dump(const char* dump)
+    {
+        //connections of sharded parser open one file from different threads
+        static std::mutex mutex;
+        std::unique_lock<std::mutex> lock(mutex);
+        struct stat st;
+        if(::fstat(hfile, &st))
+            throw_system_failure("fstat() error");
+        if(!st.st_size) {
+            if(::write(hfile, lws_dump_file_header, sizeof(lws_dump_file_header) - 1) != sizeof(lws_dump_file_header) - 1)
+                throw_system_failure("lws_dump writing error");
+        }
+        else {
+            char buf[sizeof(lws_dump_file_header) - 1];
+            int h = ::open(dump, O_RDONLY);
+            bool v2 = (h >= 0 && ::read(h, buf, sizeof(buf)) == sizeof(buf)
+                && std::equal(buf, buf + sizeof(buf), lws_dump_file_header));
+            if(h >= 0)
+                ::close(h);
+            if(!v2)
+                throw std::runtime_error(es() % "lws_dump() file " % _str_holder(dump) % " has old format, append not supported");
         }
     }
-    char dump_buf[8];
     void dump(const char* p, uint32_t sz)
     {
         if(sz) {
-            memcpy(dump_buf + 1, &sz, sizeof(sz));
-            if(::write(hfile, dump_buf, 6) != 6)
-                throw_system_failure("lws_dump writing error");
-            if(::write(hfile, p, sz) != sz)
+            lws_frame_header h = {{'\n', '\n', '\n', '\n'}, sz, get_cur_ttime()};
+            //single write for O_APPEND, connections from different threads dumps to one file
+            iovec iov[2] = {{&h, sizeof(h)}, {(void*)p, sz}};
+            if(::writev(hfile, iov, 2) != ssize_t(sz + sizeof(h)))
                 throw_system_failure("lws_dump writing error");
         }
     }
 
-    std::vector<char> read_buf;
-    uint64_t dump_readed, dump_size;
-    str_holder read_dump()
+    char* dump_ptr;
+    uint64_t dump_size, dump_readed;
+    std::vector<lws_frame> frames;
+
+    void read_index()
     {
-        if(dump_readed < dump_size)
-        {
-            if(::read(hfile, dump_buf, 6) != 6)
-                throw_system_failure("lws_dump reading error");
+        const uint32_t hs = sizeof(lws_dump_file_header) - 1;
+        bool v2 = dump_size >= hs && std::equal(dump_ptr, dump_ptr + hs, lws_dump_file_header);
+        char* it = dump_ptr + (v2 ? hs : 0), *ie = dump_ptr + dump_size;
+        while(it != ie) {
+            ttime_t time;
             uint32_t sz;
-            memcpy(&sz, dump_buf + 1, sizeof(sz));
-            read_buf.resize(sz);
-            if(dump_buf[0] != '\n' || dump_buf[5] != '\n' || ::read(hfile, &read_buf[0], sz) != sz)
-                throw_system_failure("lws_dump reading error");
-            dump_readed += (sz + 6);
-            return str_holder(&read_buf[0], sz);
+            if(v2) {
+                lws_frame_header h;
+                if(unlikely(ie - it < int64_t(sizeof(h))))
+                    throw std::runtime_error("lws_dump reading error, frame header truncated");
+                memcpy(&h, it, sizeof(h));
+                if(unlikely(h.delim[0] != '\n' || h.delim[3] != '\n'))
+                    throw std::runtime_error("lws_dump reading error, bad frame header");
+                sz = h.size;
+                time = h.time;
+                it += sizeof(h);
+            }
+            else {
+                if(unlikely(ie - it < 6 || it[0] != '\n' || it[5] != '\n'))
+                    throw std::runtime_error("lws_dump reading error, bad frame header");
+                memcpy(&sz, it + 1, sizeof(sz));
+                time = ttime_t();
+                it += 6;
+            }
+            if(unlikely(ie - it < sz))
+                throw std::runtime_error("lws_dump reading error, frame truncated");
+            frames.push_back(lws_frame{time, str_holder(it, sz)});
+            it += sz;
         }
-        return str_holder(nullptr, 0);
+    }
+
+    double fake_speed;
+    ttime_t replay_from, dump_from;
+
+    str_holder read_dump()
+    {
+        if(dump_readed == frames.size())
+            return str_holder(nullptr, 0);
+        const lws_frame& f = frames[dump_readed++];
+        if(fake_speed > 0 && f.time.value) {
+            if(unlikely(!dump_from.value)) {
+                dump_from = f.time;
+                replay_from = get_cur_ttime();
+            }
+            //frames of several connections can be slightly out of order, earlier ones replayed at once
+            uint64_t d = f.time.value > dump_from.value ? f.time.value - dump_from.value : 0;
+            uint64_t to = replay_from.value + uint64_t(d / fake_speed);
+            for(ttime_t cur = get_cur_ttime(); cur.value < to; cur = get_cur_ttime()) {
+                if(to - cur.value > 2000000)
+                    usleep((to - cur.value) / 1000 - 1000);
+            }
+        }
+        return f.data;
     }
 
     ~lws_dump()
     {
+        if(dump_ptr)
+            munmap(dump_ptr, dump_size);
         if(hfile)
             ::close(hfile);
     }
-
 };
 
-struct lws_impl : emessages, lws_dump, stack_singleton<lws_impl>
+struct lws_impl : emessages, lws_dump
 {
     char buf[512];
     buf_stream bs;
@@ -90,9 +197,14 @@ struct lws_impl : emessages, lws_dump, stack_singleton<lws_impl>
     time_t data_time;
     
     std::vector<std::string> subscribes;
+
+    //tickers of this connection, part of config tickers when parser sharded
+    std::vector<std::string> tickers;
     
-    lws_impl() : emessages(config::instance().push), bs(buf, buf + sizeof(buf) - 1), closed(), data_time(time(NULL))
+    lws_impl(const std::vector<std::string>& tickers) : emessages(config::instance().push),
+        bs(buf, buf + sizeof(buf) - 1), closed(), data_time(time(NULL)), tickers(tickers)
     {
+        set_coalesce(config::instance().coalesce, config::instance().coalesce_us);
         bs.resize(LWS_PRE);
     }
     void init(lws* wsi)
@@ -239,7 +351,7 @@ template<typename lws_w>
 void proceed_lws_parser_fake(volatile bool& can_run)
 {
     mlog() << "parser started in fake mode, from " << _str_holder(getenv("lws_fake"));
-    lws_w ls;
+    lws_w ls(config::instance().tickers);
     for(;can_run;)
     {
         str_holder str = ls.read_dump();
@@ -250,17 +362,99 @@ void proceed_lws_parser_fake(volatile bool& can_run)
         else
             break;
     }
+    ls.flush();
 }
 
+//allocations counter, increased by operator new only in *_bench binaries, see bench.hpp
+inline std::atomic<uint64_t> lws_bench_allocs;
+
+struct lws_bench_stat : stack_singleton<lws_bench_stat>
+{
+    uint64_t messages, checksum;
+    lws_bench_stat() : messages(), checksum(0xcbf29ce484222325ull)
+    {
+    }
+    void add(const message& m)
+    {
+        //parser time and unused fields not stable between runs and not checked
+        message c = m;
+        c.t.time = ttime_t();
+        if(c.id.id == msg_book)
+            memset(c.mb.unused, 0, sizeof(c.mb.unused));
+        else if(c.id.id == msg_trade) {
+            c.mt.unused = 0;
+            c.mt.unused_ = 0;
+        }
+        else if(c.id.id == msg_clean)
+            memset(c.mc.unused, 0, sizeof(c.mc.unused));
+        else if(c.id.id == msg_ping)
+            memset(c.mp.unused, 0, sizeof(c.mp.unused));
+        uint64_t v[sizeof(message) / sizeof(uint64_t)];
+        memcpy(v, &c, sizeof(c));
+        for(uint64_t w: v)
+            checksum = (checksum ^ w) * 0x100000001b3ull;
+    }
+    static void* init(const char*)
+    {
+        return &instance();
+    }
+    static void destroy(void*)
+    {
+    }
+    static void proceed(void* v, const message* m, uint32_t count)
+    {
+        lws_bench_stat& s = *(lws_bench_stat*)v;
+        s.messages += count;
+        for(uint32_t i = 0; i != count; ++i)
+            s.add(m[i]);
+    }
+};
+
 template<typename lws_w>
-void proceed_lws_parser(volatile bool& can_run)
+void proceed_lws_bench(volatile bool& can_run)
+{
+    const char* fake = getenv("lws_fake");
+    if(!fake)
+        throw std::runtime_error("proceed_lws_bench() lws_fake with lws_dump recording required");
+    const char* rc = getenv("lws_bench");
+    uint32_t runs = rc ? lexical_cast<uint32_t>(rc) : 10;
+    
+    lws_bench_stat stat;
+    register_exporter("lws_bench", {&lws_bench_stat::init, &lws_bench_stat::destroy, &lws_bench_stat::proceed});
+    config::instance().push = "lws_bench";
+    lws_w ls(config::instance().tickers);
+
+    const std::vector<lws_frame>& frames = ls.frames;
+    if(frames.empty())
+        throw std::runtime_error(es() % "proceed_lws_bench() no frames in " % _str_holder(fake));
+    mlog() << "parser bench started, frames: " << frames.size() << ", bytes: " << ls.dump_size << ", runs: " << runs;
+
+    uint64_t allocs = lws_bench_allocs, nframes = 0;
+    ttime_t from = get_cur_ttime();
+    for(uint32_t r = 0; can_run && r != runs; ++r) {
+        for(const lws_frame& f: frames)
+            ls.proceed(nullptr, (void*)f.data.str, f.data.size);
+        nframes += frames.size();
+    }
+    ls.flush();
+    ttime_t to = get_cur_ttime();
+    allocs = lws_bench_allocs - allocs;
+
+    uint64_t ns = to.value - from.value;
+    mlog() << "parser bench ended, frames: " << nframes << ", messages: " << stat.messages
+        << ", time: " << ns / 1000000 << "ms"
+        << ", ns/frame: " << (nframes ? ns / nframes : 0)
+        << ", ns/message: " << (stat.messages ? ns / stat.messages : 0)
+        << ",\n    allocs: " << allocs << ", allocs/frame: " << double(allocs) / std::max<uint64_t>(nframes, 1)
+        << ", checksum: " << stat.checksum;
+}
+
+template<typename lws_w>
+void proceed_lws_connection(volatile bool& can_run, const std::vector<std::string>& tickers)
 {
-    if(getenv("lws_fake"))
-        proceed_lws_parser_fake<lws_w>(can_run);
-    else
     while(can_run) {
         try {
-            lws_w ls;
+            lws_w ls(tickers);
             ls.context = create_context<lws_w>();
             connect(ls);
 
@@ -272,6 +466,7 @@ void proceed_lws_parser(volatile bool& can_run)
                         throw std::runtime_error(es() % " no data from " % ls.data_time);
                 }
                 n = lws_service(ls.context, 0);
+                ls.flush();
             }
         } catch(std::exception& e) {
             mlog() << "proceed_lws_parser " << e;
@@ -284,3 +479,28 @@ void proceed_lws_parser(volatile bool& can_run)
     }
 }
 
+template<typename lws_w>
+void proceed_lws_parser(volatile bool& can_run)
+{
+    const std::vector<std::string>& tickers = config::instance().tickers;
+    uint32_t connections = std::min<uint32_t>(config::instance().connections, tickers.size());
+    if(getenv("lws_fake"))
+        proceed_lws_parser_fake<lws_w>(can_run);
+    else if(connections < 2)
+        proceed_lws_connection<lws_w>(can_run, tickers);
+    else {
+        //tickers sharded by connections, every connection parsed in own thread
+        //with own lws_context, security ids and messages batch, all pushed to the same target
+        std::vector<std::vector<std::string> > shards(connections);
+        for(uint32_t i = 0; i != tickers.size(); ++i)
+            shards[i % connections].push_back(tickers[i]);
+        mlog() << "proceed_lws_parser() " << connections << " connections";
+        std::vector<std::thread> threads;
+        for(uint32_t i = 1; i != connections; ++i)
+            threads.push_back(std::thread(&proceed_lws_connection<lws_w>, std::ref(can_run), std::cref(shards[i])));
+        proceed_lws_connection<lws_w>(can_run, shards[0]);
+        for(auto& t: threads)
+            t.join();
+    }
+}
+
@@ -32,14 +32,18 @@ struct parser : emessages, stack_singleton<parser>
     {
         send_messages();
     }
-    void set_order(tickers_type::iterator it, int64_t replID, price_t price, count_t count, ttime_t etime)
+    //consumer for decoders generated by plaza_templater
+    void set_order(int32_t isin_id, int64_t id, price_t price, count_t count, ttime_t etime)
     {
-        security& s = it->second;
-        add_order(s.mi.security_id, replID, price, count, etime, ptime);
+        auto it = tickers.find(isin_id);
+        if(it != tickers.end())
+            add_order(it->second.mi.security_id, id, price, count, etime, ptime);
     }
-    void set_trade(tickers_type::iterator it, price_t price, count_t count, uint32_t direction, ttime_t etime)
+    void set_trade(int32_t isin_id, price_t price, count_t count, uint32_t direction, ttime_t etime)
     {
-        add_trade(it->second.mi.security_id, price, count, direction, etime, ptime);
+        auto it = tickers.find(isin_id);
+        if(it != tickers.end())
+            add_trade(it->second.mi.security_id, price, count, direction, etime, ptime);
     }
 
     volatile bool tickers_initialized;
@@ -223,36 +227,17 @@ CG_RESULT instruments_callback(cg_conn_t*, cg_listener_t*, struct cg_msg_t* msg,
     return CG_ERR_OK;
 }
 
-CG_RESULT orders_callback(cg_conn_t*, cg_listener_t*, struct cg_msg_t* msg, void* p)
+CG_RESULT orders_callback(cg_conn_t*, cg_listener_t*, struct cg_msg_t* msg, void*)
 {
     switch (msg->type)
     {
     case CG_MSG_STREAM_DATA: 
         {
-            if(unlikely(msg->data_size != sizeof(orders_aggr))){
+            if(unlikely(!cg_decode<orders_aggr>(msg, parser::instance()))){
                 throw std::runtime_error("proceed_order not orders_aggr received");
             }
-            orders_aggr* o = (orders_aggr*)msg->data;
-            parser::tickers_type& tickers = *((parser::tickers_type*)p);
-            auto it = tickers.find(o->isin_id);
-            if(it == tickers.end()) {
-                break;
-            }
-            price_t price = *o->price;
-            count_t count = {o->volume * count_t::frac};
-            ttime_t etime = {o->moment_ns};
-            if(o->dir == 2)
-                count.value = -count.value;
-            else if(likely(o->dir == 1))
-            {
-            }
-            else {
-                o->print_brief();
-                throw std::runtime_error("orders_aggr bad dir");
-            }
-            parser::instance().set_order(it, o->replID, price, count, etime);
-            o->print_brief();
-            //s.proceed_book(parser::instance().e, price, count, etime);
+            if(config::instance().log_plaza)
+                ((orders_aggr*)msg->data)->print_brief();
             break;
         }
     case CG_MSG_TN_BEGIN:
@@ -322,30 +307,16 @@ CG_RESULT orders_callback(cg_conn_t*, cg_listener_t*, struct cg_msg_t* msg, void
 }
 
 bool deals_online = false;
-CG_RESULT trades_callback(cg_conn_t*, cg_listener_t*, struct cg_msg_t* msg, void* p)
+CG_RESULT trades_callback(cg_conn_t*, cg_listener_t*, struct cg_msg_t* msg, void*)
 {
     switch (msg->type)
     {
     case CG_MSG_STREAM_DATA: 
         {
             if(likely(deals_online)) {
-                if(msg->data_size == sizeof(deal)) {
-                    deal* d = (deal*)msg->data;
-                    parser::tickers_type& tickers = *((parser::tickers_type*)p);
-                    auto it = tickers.find(d->isin_id);
-                    if(it == tickers.end()) {
-                        break;
-                    }
-                    uint32_t direction = 0;
-                    if(d->id_ord_buy > d->id_ord_sell)
-                        direction = 1;
-                    else if(d->id_ord_sell > d->id_ord_buy)
-                        direction = 2;
-                    price_t price = *d->price;
-                    count_t count = {d->xamount * count_t::frac};
-                    ttime_t etime = {d->moment_ns};
-                    parser::instance().set_trade(it, price, count, direction, etime);
-                    d->print_brief();
+                if(cg_decode<deal>(msg, parser::instance())) {
+                    if(config::instance().log_plaza)
+                        ((deal*)msg->data)->print_brief();
                 }
                 else if (msg->data_size == sizeof(heartbeat)) {
                     heartbeat* h = (heartbeat*)msg->data;
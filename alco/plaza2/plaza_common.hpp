@@ -100,6 +100,27 @@ mlog& operator<<(mlog& ml, const cg_string<sz>& str)
 }
 
 
+inline void cg_scale(int64_t& value, int32_t ds)
+{
+    if(!ds) {
+    }
+    else if(ds > 0) {
+        value /= my_cvt::decimal_pow[ds];
+    }
+    else {
+        value *= my_cvt::decimal_pow[-ds];
+    }
+}
+
+template<int32_t ds>
+inline void cg_scale(int64_t& value)
+{
+    if constexpr(ds > 0)
+        value /= int64_t(my_cvt::p10<ds>());
+    else if constexpr(ds < 0)
+        value *= int64_t(my_cvt::p10<-ds>());
+}
+
 template<uint32_t m, uint32_t e>
 struct cg_decimal
 {
@@ -107,21 +128,22 @@ struct cg_decimal
     cg_decimal(){
         memset(buf, 0, sizeof(buf));
     }
-    price_t operator*() const{
-        price_t ret;
+    //type is price_t or count_t, scale from scheme known at compile time,
+    //runtime scaling only if cgate returned other one
+    template<typename type>
+    type as() const{
+        type ret;
         int8_t s;
         cg_bcd_get((void*)buf, &ret.value, &s);
-        int8_t ds = s + price_t::exponent;
-        if(!ds) {
-        }
-        else if(ds > 0) {
-            ret.value /= my_cvt::decimal_pow[ds];
-        }
-        else {
-            ret.value *= my_cvt::decimal_pow[-ds];
-        }
+        if(likely(s == int8_t(e)))
+            cg_scale<int32_t(e) + type::exponent>(ret.value);
+        else
+            cg_scale(ret.value, s + type::exponent);
         return ret;
     }
+    price_t operator*() const{
+        return as<price_t>();
+    }
 };
 
 template<uint32_t m, uint32_t e>
@@ -162,6 +184,17 @@ inline void warn_plaza_fail(uint32_t res, const char* msg)
     }
 } 
 
+//decode() for book and trade tables generated by plaza_templater,
+//consumer receives set_order(isin_id, id, price, count, etime) or set_trade(isin_id, price, count, direction, etime)
+template<typename table, typename consumer>
+inline bool cg_decode(const cg_msg_t* msg, consumer& c)
+{
+    if(unlikely(msg->data_size != sizeof(table)))
+        return false;
+    decode(*((const table*)msg->data), c);
+    return true;
+}
+
 struct cg_conn_h
 {
     cg_conn_t *cli;
@@ -82,11 +82,13 @@ struct skelet
     uint32_t structure_size;
     bool have_alignment;
     std::string nullable; //WTF IS THIS ?????
+    std::vector<uint32_t> offsets;
     void add_size(uint32_t sz, uint32_t granularity) {
         granularity = std::min(uint32_t(4), granularity);
         uint32_t st_from = structure_size % granularity;
         if(st_from)
             structure_size += (granularity - st_from);
+        offsets.push_back(structure_size);
         structure_size += sz;
     }
     std::set<std::string> c_types;
@@ -106,6 +108,7 @@ struct skelet
         reply = optional<bool>();
         replies.clear();
         types.clear();
+        offsets.clear();
         c_types.clear();
         structure_size = 0;
     }
@@ -196,6 +199,65 @@ struct skelet
         for(const auto& s: tmp)
             replies.push_back(lexical_cast<uint32_t>(s));
     }
+    int32_t find_field(std::initializer_list<const char*> names) const {
+        for(const char* n: names) {
+            for(uint32_t i = 0; i != types.size(); ++i) {
+                if(std::get<0>(types[i]) == n)
+                    return i;
+            }
+        }
+        return -1;
+    }
+    bool is_decimal(int32_t f) const {
+        return std::get<1>(types[f]).find("cg_decimal<") == 0;
+    }
+    std::string count_value(int32_t f) const {
+        const std::string& n = std::get<0>(types[f]);
+        if(is_decimal(f))
+            return "v." + n + ".as<count_t>()";
+        return "{v." + n + " * count_t::frac}";
+    }
+    //decoder from table to set_order() or set_trade() of consumer, fields found by names,
+    //so it generated for order books (dir field present) and deals (id_ord_buy and id_ord_sell present)
+    void write_decoder(std::ostream& str, const std::string& table) const {
+        int32_t isin = find_field({"isin_id"}), price = find_field({"price"}), time = find_field({"moment_ns"});
+        if(isin == -1 || price == -1 || time == -1 || !is_decimal(price))
+            return;
+        int32_t buy = find_field({"id_ord_buy"}), sell = find_field({"id_ord_sell"}), dir = find_field({"dir"});
+        int32_t id = find_field({"id_ord", "replID"}), amount = (buy != -1 && sell != -1)
+            ? find_field({"xamount", "amount"}) : find_field({"xamount_rest", "volume", "amount", "xamount"});
+        bool trade = (buy != -1 && sell != -1);
+        if(amount == -1 || (!trade && (dir == -1 || id == -1)))
+            return;
+        std::vector<int32_t> fields = trade ? std::vector<int32_t>{isin, price, time, buy, sell, amount}
+            : std::vector<int32_t>{isin, price, time, dir, id, amount};
+        str << "    template<typename consumer>" << std::endl
+            << "    inline void decode(const " << table << "& v, consumer& c)" << std::endl
+            << "    {" << std::endl;
+        for(int32_t f: fields)
+            str << "        static_assert(offsetof(" << table << ", " << std::get<0>(types[f]) << ") == " << offsets[f]
+                << ", \"" << table << "::" << std::get<0>(types[f]) << "\");" << std::endl;
+        str << "        count_t count = " << count_value(amount) << ";" << std::endl;
+        const std::string& p = std::get<0>(types[price]), &i = std::get<0>(types[isin]), &t = std::get<0>(types[time]);
+        if(trade) {
+            const std::string& b = std::get<0>(types[buy]), &s = std::get<0>(types[sell]);
+            str << "        uint32_t direction = 0;" << std::endl
+                << "        if(v." << b << " > v." << s << ")" << std::endl
+                << "            direction = 1;" << std::endl
+                << "        else if(v." << s << " > v." << b << ")" << std::endl
+                << "            direction = 2;" << std::endl
+                << "        c.set_trade(v." << i << ", v." << p << ".as<price_t>(), count, direction, ttime_t{v." << t << "});" << std::endl;
+        }
+        else {
+            const std::string& d = std::get<0>(types[dir]);
+            str << "        if(v." << d << " == 2)" << std::endl
+                << "            count.value = -count.value;" << std::endl
+                << "        else if(unlikely(v." << d << " != 1))" << std::endl
+                << "            throw std::runtime_error(es() % \"" << table << " bad " << d << ": \" % int32_t(v." << d << "));" << std::endl
+                << "        c.set_order(v." << i << ", v." << std::get<0>(types[id]) << ", v." << p << ".as<price_t>(), count, ttime_t{v." << t << "});" << std::endl;
+        }
+        str << "    }" << std::endl;
+    }
     template<typename value>
     static void write_body_value(std::ostream& of, const std::string& type, const value& v) {
         of << "        " << type << " " << v << ";" << std::endl;
@@ -307,6 +369,7 @@ struct skelet
         close_structure_size();
         str << "    };" << std::endl;
         str << "    static_assert(sizeof(" << ctx.table_name << ") == " << structure_size << ", \"" << ctx.table_name << "\");" << std::endl;
+        write_decoder(str, ctx.table_name);
         std::map<std::string, std::string>& cur = ctx.saved_structures[ctx.cur_namespace];
         std::string cur_str = str.str();
         auto it = cur.find(ctx.table_name);
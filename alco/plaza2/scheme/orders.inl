@@ -27,6 +27,22 @@ namespace CustReplScheme
         }
     };
     static_assert(sizeof(orders_aggr) == 72, "orders_aggr");
+    template<typename consumer>
+    inline void decode(const orders_aggr& v, consumer& c)
+    {
+        static_assert(offsetof(orders_aggr, isin_id) == 24, "orders_aggr::isin_id");
+        static_assert(offsetof(orders_aggr, price) == 28, "orders_aggr::price");
+        static_assert(offsetof(orders_aggr, moment_ns) == 60, "orders_aggr::moment_ns");
+        static_assert(offsetof(orders_aggr, dir) == 68, "orders_aggr::dir");
+        static_assert(offsetof(orders_aggr, replID) == 0, "orders_aggr::replID");
+        static_assert(offsetof(orders_aggr, volume) == 40, "orders_aggr::volume");
+        count_t count = {v.volume * count_t::frac};
+        if(v.dir == 2)
+            count.value = -count.value;
+        else if(unlikely(v.dir != 1))
+            throw std::runtime_error(es() % "orders_aggr bad dir: " % int32_t(v.dir));
+        c.set_order(v.isin_id, v.replID, v.price.as<price_t>(), count, ttime_t{v.moment_ns});
+    }
 }}
 using FORTS_FUTAGGR50_REPL::CustReplScheme::orders_aggr;
 #pragma pack(pop)
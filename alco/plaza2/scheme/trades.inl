@@ -33,6 +33,23 @@ namespace CustReplScheme
         }
     };
     static_assert(sizeof(deal) == 108, "deal");
+    template<typename consumer>
+    inline void decode(const deal& v, consumer& c)
+    {
+        static_assert(offsetof(deal, isin_id) == 28, "deal::isin_id");
+        static_assert(offsetof(deal, price) == 72, "deal::price");
+        static_assert(offsetof(deal, moment_ns) == 96, "deal::moment_ns");
+        static_assert(offsetof(deal, id_ord_buy) == 56, "deal::id_ord_buy");
+        static_assert(offsetof(deal, id_ord_sell) == 64, "deal::id_ord_sell");
+        static_assert(offsetof(deal, xamount) == 48, "deal::xamount");
+        count_t count = {v.xamount * count_t::frac};
+        uint32_t direction = 0;
+        if(v.id_ord_buy > v.id_ord_sell)
+            direction = 1;
+        else if(v.id_ord_sell > v.id_ord_buy)
+            direction = 2;
+        c.set_trade(v.isin_id, v.price.as<price_t>(), count, direction, ttime_t{v.moment_ns});
+    }
     struct heartbeat
     {
         static constexpr uint32_t plaza_size = 34;
@@ -5,6 +5,9 @@
 #pragma once
 
 #include "evie/fmap.hpp"
+#include "evie/perfect_hash.hpp"
+
+#include <map>
 
 static std::string join_tickers(std::vector<std::string> tickers, bool quotes = true)
 {
@@ -21,26 +24,108 @@ static std::string join_tickers(std::vector<std::string> tickers, bool quotes =
     return s.str();
 }
 
+//local order book of one security for validation of exchange checksums and sequences,
+//levels keep exchange strings as checksums calculated over them
+struct local_book
+{
+    typedef my_basic_string<char, 32> value;
+    struct level
+    {
+        value price; //order id for books by orders
+        value amount;
+    };
+    //price and order id, order id used only in books by orders
+    typedef std::pair<int64_t, int64_t> key;
+    std::map<key, level> bids, asks;
+
+    uint64_t seq;
+    bool resync; //waiting for snapshot after mismatch, updates ignored
+
+    local_book() : seq(), resync()
+    {
+    }
+    void clear()
+    {
+        bids.clear();
+        asks.clear();
+        seq = 0;
+    }
+    void set(bool ask, key k, str_holder price, str_holder amount)
+    {
+        level& l = (ask ? asks : bids)[k];
+        l.price = price;
+        l.amount = amount;
+    }
+    bool erase(bool ask, key k)
+    {
+        return (ask ? asks : bids).erase(k);
+    }
+    bool has(bool ask, key k) const
+    {
+        const std::map<key, level>& m = ask ? asks : bids;
+        return m.find(k) != m.end();
+    }
+    //drop levels behind subscribed depth, exchanges do not send removes for them
+    void truncate(uint32_t depth)
+    {
+        while(asks.size() > depth)
+            asks.erase(std::prev(asks.end()));
+        while(bids.size() > depth)
+            bids.erase(bids.begin());
+    }
+    //f(const level& l) called for best levels from top
+    template<typename func>
+    void top_asks(uint32_t count, func f) const
+    {
+        for(auto it = asks.begin(); count && it != asks.end(); --count, ++it)
+            f(it->second);
+    }
+    template<typename func>
+    void top_bids(uint32_t count, func f) const
+    {
+        for(auto it = bids.rbegin(); count && it != bids.rend(); --count, ++it)
+            f(it->second);
+    }
+};
+
 template<typename base>
 struct sec_id_by_name : base
 {
     typedef my_basic_string<char, sizeof(message_instr::security) + 1> ticker;
+    sec_id_by_name(const std::vector<std::string>& tickers) : base(tickers)
+    {
+    }
     uint32_t get_security_id(const char* i, const char* ie, ttime_t time)
     {
-        ticker symbol(i, ie);
-        auto it = securities.find(symbol);
-        if(unlikely(it == securities.end())) {
-            tmp.init(config::instance().exchange_id, config::instance().feed_id, std::string(i, ie));
-            securities[symbol] = tmp.mi.security_id;
-            tmp.proceed_instr(this->e, time);
-            return tmp.mi.security_id;
-        }
-        else
-            return it->second;
+        uint32_t* id = securities.find(i, ie - i);
+        if(likely(id))
+            return *id;
+        tmp.init(config::instance().exchange_id, config::instance().feed_id, std::string(i, ie));
+        securities.insert(str_holder(i, ie - i), tmp.mi.security_id);
+        //instrument exported directly, coalesced messages should not be reordered with it
+        this->flush();
+        tmp.proceed_instr(this->e, time);
+        return tmp.mi.security_id;
+    }
+
+    //optional local books, filled only by parsers with book validation enabled
+    std::map<uint32_t, local_book> books; //security_id, book
+
+    //exported book of security broken, clean it and wait snapshot,
+    //parser itself should resubscribe
+    void book_mismatch(uint32_t security_id, ttime_t time, str_holder reason)
+    {
+        mlog(mlog::critical) << "book mismatch for security_id: " << security_id << ", " << reason;
+        local_book& b = books[security_id];
+        b.clear();
+        b.resync = true;
+        this->add_clean(security_id, ttime_t(), time);
+        this->flush();
     }
 
 private:
-    fmap<ticker, uint32_t> securities;
+    //table rebuilt on every new ticker, that happens only until all subscribed instruments announced
+    perfect_hash<uint32_t, sizeof(message_instr::security) + 1> securities;
     security tmp;
 };
 
@@ -0,0 +1,634 @@
+/*
+    This file contains benchmarks of evie concurrency primitives and reference implementations
+    Usage: ./evie_bench [filter] [threads] [pin] [ops]
+        filter: substring of benchmark name (lockfree_queue, fast_alloc, follower, lockfree_list, fmap, my_mutex), all by default
+        threads: N for N:1, 1:N, N:N configurations, 4 by default
+        pin: 1 binds every thread to own cpu, 0 by default
+        ops: operations of every producer, 1000000 by default
+
+    author: Ilya Andronov <sni4ok@yandex.ru>
+*/
+
+#include "fast_alloc.hpp"
+#include "fmap.hpp"
+#include "mutex.hpp"
+#include "profiler.hpp"
+
+#include <map>
+#include <list>
+#include <deque>
+#include <thread>
+#include <chrono>
+#include <random>
+#include <unordered_map>
+
+#include <pthread.h>
+#include <sched.h>
+
+namespace
+{
+    std::string filter = "all";
+    uint32_t threads = 4, ops = 1000000;
+    bool pin = false;
+
+    uint64_t now()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    inline void pause()
+    {
+        __builtin_ia32_pause();
+    }
+
+    //spin for latency, yield sometimes for machines with less cpus than threads
+    struct backoff
+    {
+        uint32_t fails = 0;
+        void operator()()
+        {
+            if(++fails % 64)
+                pause();
+            else
+                sched_yield();
+        }
+    };
+
+    void pin_thread(uint32_t idx)
+    {
+        if(!pin)
+            return;
+        cpu_set_t cpuset;
+        CPU_ZERO(&cpuset);
+        CPU_SET(idx % std::thread::hardware_concurrency(), &cpuset);
+        if(pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpuset))
+            mlog(mlog::critical) << "pthread_setaffinity_np() error";
+    }
+
+    //runs f(thread_idx) in count threads started together, returns seconds from start to last join
+    template<typename func>
+    double run_threads(uint32_t count, func f)
+    {
+        std::atomic<uint32_t> ready(0);
+        std::atomic<bool> go(false);
+        std::vector<std::thread> ts;
+        for(uint32_t i = 0; i != count; ++i) {
+            ts.push_back(std::thread([&, i]() {
+                pin_thread(i);
+                ++ready;
+                while(!go)
+                    sched_yield();
+                f(i);
+            }));
+        }
+        while(ready != count)
+            sched_yield();
+        uint64_t from = now();
+        go = true;
+        for(auto& t: ts)
+            t.join();
+        return double(now() - from) / 1e9;
+    }
+
+    //latency samples of threads merged after join
+    struct latencies
+    {
+        std::mutex mutex;
+        std::vector<uint64_t> all;
+
+        void add(std::vector<uint64_t>& v)
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            all.insert(all.end(), v.begin(), v.end());
+        }
+    };
+
+    void report(const std::string& name, uint64_t count, double seconds, std::vector<uint64_t>& lat)
+    {
+        mlog ml;
+        ml << name << ": " << uint64_t(count / seconds) << " ops/s";
+        if(!lat.empty()) {
+            std::sort(lat.begin(), lat.end());
+            auto pc = [&lat](double p) {
+                return lat[std::min<uint64_t>(lat.size() - 1, uint64_t(lat.size() * p))];
+            };
+            ml << ", latency ns p50: " << pc(0.5) << ", p99: " << pc(0.99) << ", p99.9: " << pc(0.999) << ", max: " << lat.back();
+        }
+    }
+
+    bool enabled(const std::string& name)
+    {
+        return filter == "all" || name.find(filter) != std::string::npos;
+    }
+
+    //configurations of producers and consumers
+    std::vector<std::pair<uint32_t, uint32_t> > configs()
+    {
+        return {{1, 1}, {threads, 1}, {1, threads}, {threads, threads}};
+    }
+
+    std::string config_name(const std::string& name, uint32_t size, uint32_t producers, uint32_t consumers)
+    {
+        return name + " " + std::to_string(size) + "B " + std::to_string(producers) + ":" + std::to_string(consumers);
+    }
+
+    template<uint32_t size>
+    struct element
+    {
+        uint64_t time;
+        char data[size - sizeof(uint64_t)];
+    };
+    template<>
+    struct element<8>
+    {
+        uint64_t time;
+    };
+
+    static const uint32_t sample = 16;
+
+    //lockfree_queue throws on overflow, so producers reserve place before push as users of queue do
+    template<uint32_t size>
+    void bench_lockfree_queue(uint32_t producers, uint32_t consumers)
+    {
+        typedef lockfree_queue<element<size>, 1024> queue;
+        std::unique_ptr<queue> q = std::make_unique<queue>("bench_queue");
+        std::atomic<int32_t> in_flight(0);
+        std::atomic<uint64_t> popped(0);
+        uint64_t total = uint64_t(ops) * producers;
+        latencies l;
+        double s = run_threads(producers + consumers, [&](uint32_t idx) {
+            if(idx < producers) {
+                element<size> e = element<size>();
+                for(uint32_t i = 0; i != ops; ++i) {
+                    backoff b;
+                    while(in_flight.fetch_add(1) >= int32_t(queue::capacity)) {
+                        --in_flight;
+                        b();
+                    }
+                    e.time = now();
+                    q->push(e);
+                }
+            }
+            else {
+                std::vector<uint64_t> lat;
+                element<size> e;
+                backoff b;
+                while(popped < total) {
+                    if(q->pop_weak(e)) {
+                        --in_flight;
+                        if(!(popped++ % sample))
+                            lat.push_back(now() - e.time);
+                    }
+                    else
+                        b();
+                }
+                l.add(lat);
+            }
+        });
+        report(config_name("lockfree_queue", size, producers, consumers), total, s, l.all);
+    }
+
+    template<uint32_t size>
+    void bench_mutex_queue(uint32_t producers, uint32_t consumers)
+    {
+        std::mutex mutex;
+        std::deque<element<size> > q;
+        std::atomic<uint64_t> popped(0);
+        uint64_t total = uint64_t(ops) * producers;
+        latencies l;
+        double s = run_threads(producers + consumers, [&](uint32_t idx) {
+            if(idx < producers) {
+                element<size> e = element<size>();
+                for(uint32_t i = 0; i != ops; ++i) {
+                    backoff b;
+                    for(;;) {
+                        std::unique_lock<std::mutex> lock(mutex);
+                        if(q.size() < 1024)
+                            break;
+                        lock.unlock();
+                        b();
+                    }
+                    e.time = now();
+                    std::unique_lock<std::mutex> lock(mutex);
+                    q.push_back(e);
+                }
+            }
+            else {
+                std::vector<uint64_t> lat;
+                element<size> e;
+                backoff b;
+                while(popped < total) {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    if(!q.empty()) {
+                        e = q.front();
+                        q.pop_front();
+                        lock.unlock();
+                        if(!(popped++ % sample))
+                            lat.push_back(now() - e.time);
+                    }
+                    else {
+                        lock.unlock();
+                        b();
+                    }
+                }
+                l.add(lat);
+            }
+        });
+        report(config_name("reference std::mutex + std::deque", size, producers, consumers), total, s, l.all);
+    }
+
+    template<uint32_t size>
+    void bench_queues()
+    {
+        for(auto c: configs()) {
+            bench_lockfree_queue<size>(c.first, c.second);
+            bench_mutex_queue<size>(c.first, c.second);
+        }
+    }
+
+    //alloc in producers, free in consumers, pointers passed by single producer single consumer rings
+    template<uint32_t size, typename alloc, typename free>
+    void bench_alloc_pairs(const std::string& name, uint32_t pairs, alloc a, free f)
+    {
+        static const uint32_t ring = 1024;
+        std::vector<std::atomic<element<size>*> > rings(pairs * ring);
+        latencies l;
+        double s = run_threads(pairs * 2, [&](uint32_t idx) {
+            std::vector<uint64_t> lat;
+            std::atomic<element<size>*>* r = &rings[(idx / 2) * ring];
+            for(uint32_t i = 0; i != ops; ++i) {
+                std::atomic<element<size>*>& slot = r[i % ring];
+                backoff b;
+                if(!(idx % 2)) {
+                    while(slot.load(std::memory_order_acquire))
+                        b();
+                    uint64_t t = now();
+                    element<size>* e = a();
+                    if(!(i % sample))
+                        lat.push_back(now() - t);
+                    slot.store(e, std::memory_order_release);
+                }
+                else {
+                    element<size>* e;
+                    while(!(e = slot.load(std::memory_order_acquire)))
+                        b();
+                    slot.store(nullptr, std::memory_order_relaxed);
+                    f(e);
+                }
+            }
+            l.add(lat);
+        });
+        report(config_name(name + " cross thread alloc", size, pairs, pairs), uint64_t(ops) * pairs, s, l.all);
+    }
+
+    //every thread allocates batch and frees it
+    template<uint32_t size, typename alloc, typename free>
+    void bench_alloc_local(const std::string& name, uint32_t count, alloc a, free f)
+    {
+        latencies l;
+        double s = run_threads(count, [&](uint32_t) {
+            std::vector<uint64_t> lat;
+            element<size>* batch[16];
+            for(uint32_t i = 0; i < ops; i += 16) {
+                uint64_t t = now();
+                for(uint32_t j = 0; j != 16; ++j)
+                    batch[j] = a();
+                for(uint32_t j = 0; j != 16; ++j)
+                    f(batch[j]);
+                lat.push_back((now() - t) / 32);
+            }
+            l.add(lat);
+        });
+        report(config_name(name + " same thread alloc+free", size, count, count), uint64_t(ops) * count, s, l.all);
+    }
+
+    template<uint32_t size>
+    void bench_fast_alloc()
+    {
+        typedef fast_alloc<element<size>, 4096> pool;
+        std::unique_ptr<pool> p = std::make_unique<pool>("bench_pool");
+        auto a = [&p]() {return p->alloc();};
+        auto f = [&p](element<size>* e) {p->free(e);};
+        auto na = []() {return new element<size>;};
+        auto nf = [](element<size>* e) {delete e;};
+        for(uint32_t t: {1u, threads}) {
+            bench_alloc_local<size>("fast_alloc", t, a, f);
+            bench_alloc_local<size>("reference new/delete", t, na, nf);
+            bench_alloc_pairs<size>("fast_alloc", t, a, f);
+            bench_alloc_pairs<size>("reference new/delete", t, na, nf);
+        }
+    }
+
+    //short living threads use pool and end, elements added to depot for every thread cache
+    //should be returned after join, so pool keeps its size and depot queues not overloaded
+    void bench_fast_alloc_threads()
+    {
+        typedef fast_alloc<element<64>, 4096> pool;
+        std::unique_ptr<pool> p = std::make_unique<pool>("bench_threads_pool");
+        static const uint32_t rounds = 2048;
+        uint64_t from = now();
+        for(uint32_t r = 0; r != rounds; ++r) {
+            run_threads(threads, [&](uint32_t) {
+                element<64>* batch[16];
+                for(uint32_t j = 0; j != 16; ++j)
+                    batch[j] = p->alloc();
+                for(uint32_t j = 0; j != 16; ++j)
+                    p->free(batch[j]);
+            });
+        }
+        double s = double(now() - from) / 1e9;
+        std::vector<element<64>*> all;
+        for(uint32_t i = 0; i != pool::capacity + 2 * pool::mag_size; ++i)
+            all.push_back(p->alloc());
+        bool grown = true;
+        try {
+            all.push_back(p->alloc());
+        }
+        catch(std::exception&) {
+            grown = false;
+        }
+        for(element<64>* e: all)
+            p->free(e);
+        if(grown)
+            throw std::runtime_error("fast_alloc pool grown by ended threads");
+        mlog() << "fast_alloc thread start+join " << threads << " threads: " << uint64_t(rounds * threads / s) << " threads/s, "
+            << rounds * threads << " threads, pool size kept";
+    }
+
+    //one writer, readers wait every element and measure time from push to visibility
+    void bench_follower(uint32_t readers)
+    {
+        std::unique_ptr<follower<uint64_t> > fl = std::make_unique<follower<uint64_t> >();
+        latencies l;
+        double s = run_threads(readers + 1, [&](uint32_t idx) {
+            if(!idx) {
+                for(uint32_t i = 0; i != ops; ++i)
+                    fl->push_back(now());
+            }
+            else {
+                std::vector<uint64_t> lat;
+                backoff b;
+                for(uint32_t i = 0; i != ops; ) {
+                    uint32_t size = fl->size();
+                    if(size == i) {
+                        b();
+                        continue;
+                    }
+                    uint64_t t = now();
+                    for(; i != size; ++i) {
+                        if(!(i % sample))
+                            lat.push_back(t - (*fl)[i]);
+                    }
+                }
+                l.add(lat);
+            }
+        });
+        report(config_name("follower", sizeof(uint64_t), 1, readers), ops, s, l.all);
+    }
+
+    void bench_shared_vector(uint32_t readers)
+    {
+        std::shared_mutex mutex;
+        std::vector<uint64_t> v;
+        latencies l;
+        double s = run_threads(readers + 1, [&](uint32_t idx) {
+            if(!idx) {
+                for(uint32_t i = 0; i != ops; ++i) {
+                    std::unique_lock<std::shared_mutex> lock(mutex);
+                    v.push_back(now());
+                }
+            }
+            else {
+                std::vector<uint64_t> lat;
+                backoff b;
+                for(uint32_t i = 0; i != ops; ) {
+                    std::shared_lock<std::shared_mutex> lock(mutex);
+                    uint32_t size = v.size();
+                    if(size == i) {
+                        lock.unlock();
+                        b();
+                        continue;
+                    }
+                    uint64_t t = now();
+                    for(; i != size; ++i) {
+                        if(!(i % sample))
+                            lat.push_back(t - v[i]);
+                    }
+                }
+                l.add(lat);
+            }
+        });
+        report(config_name("reference std::shared_mutex + std::vector", sizeof(uint64_t), 1, readers), ops, s, l.all);
+    }
+
+    struct list_value
+    {
+        uint64_t time;
+    };
+
+    //producers push preallocated nodes, one reader follows list
+    void bench_lockfree_list(uint32_t producers)
+    {
+        typedef lockfree_list<list_value> list;
+        std::unique_ptr<list> ls = std::make_unique<list>();
+        std::vector<list::node> nodes(uint64_t(ops) * producers);
+        uint64_t total = nodes.size();
+        latencies l;
+        double s = run_threads(producers + 1, [&](uint32_t idx) {
+            if(idx) {
+                list::node* n = &nodes[uint64_t(idx - 1) * ops];
+                for(uint32_t i = 0; i != ops; ++i, ++n) {
+                    n->time = now();
+                    ls->push(n);
+                }
+            }
+            else {
+                std::vector<uint64_t> lat;
+                list::node* prev = nullptr, *n;
+                backoff b;
+                for(uint64_t i = 0; i != total; ) {
+                    if(!(n = ls->next(prev))) {
+                        b();
+                        continue;
+                    }
+                    if(!(i++ % sample))
+                        lat.push_back(now() - n->time);
+                    prev = n;
+                }
+                l.add(lat);
+            }
+        });
+        report(config_name("lockfree_list", sizeof(list_value), producers, 1), total, s, l.all);
+    }
+
+    void bench_mutex_list(uint32_t producers)
+    {
+        std::mutex mutex;
+        std::list<list_value> ls;
+        uint64_t total = uint64_t(ops) * producers;
+        latencies l;
+        double s = run_threads(producers + 1, [&](uint32_t idx) {
+            if(idx) {
+                for(uint32_t i = 0; i != ops; ++i) {
+                    list_value v{now()};
+                    std::unique_lock<std::mutex> lock(mutex);
+                    ls.push_back(v);
+                }
+            }
+            else {
+                std::vector<uint64_t> lat;
+                backoff b;
+                for(uint64_t i = 0; i != total; ) {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    if(ls.empty()) {
+                        lock.unlock();
+                        b();
+                        continue;
+                    }
+                    list_value v = ls.front();
+                    ls.pop_front();
+                    lock.unlock();
+                    if(!(i++ % sample))
+                        lat.push_back(now() - v.time);
+                }
+                l.add(lat);
+            }
+        });
+        report(config_name("reference std::mutex + std::list", sizeof(list_value), producers, 1), total, s, l.all);
+    }
+
+    //random lookups of existing keys, latency per lookup measured by batches of 64
+    template<typename map>
+    void bench_map(const std::string& name, uint32_t keys)
+    {
+        std::mt19937 rnd(keys);
+        std::vector<uint32_t> ks(keys);
+        map m;
+        uint64_t from = now();
+        for(uint32_t& k: ks) {
+            k = rnd();
+            m[k] = k;
+        }
+        double build = double(now() - from) / keys;
+
+        std::vector<uint64_t> lat;
+        uint64_t sum = 0;
+        from = now();
+        for(uint32_t i = 0; i < ops; i += 64) {
+            uint64_t t = now();
+            for(uint32_t j = 0; j != 64; ++j)
+                sum += m.find(ks[rnd() % keys])->second;
+            lat.push_back((now() - t) / 64);
+        }
+        double s = double(now() - from) / 1e9;
+        report(name + " " + std::to_string(keys) + " keys find", ops, s, lat);
+        mlog() << name << " " << keys << " keys insert: " << uint64_t(build) << " ns/op, checksum: " << sum % 10;
+    }
+
+    void bench_fmap()
+    {
+        for(uint32_t keys: {16u, 256u, 4096u}) {
+            bench_map<fmap<uint32_t, uint64_t> >("fmap", keys);
+            bench_map<std::map<uint32_t, uint64_t> >("reference std::map", keys);
+            bench_map<std::unordered_map<uint32_t, uint64_t> >("reference std::unordered_map", keys);
+        }
+    }
+
+    struct spin_mutex
+    {
+        std::atomic_flag flag = ATOMIC_FLAG_INIT;
+        void lock()
+        {
+            backoff b;
+            while(flag.test_and_set(std::memory_order_acquire))
+                b();
+        }
+        void unlock()
+        {
+            flag.clear(std::memory_order_release);
+        }
+    };
+
+    //threads increment shared counter under lock, latency is time of lock acquire
+    template<typename mutex>
+    void bench_lock(const std::string& name, uint32_t count)
+    {
+        mutex m;
+        uint64_t counter = 0;
+        latencies l;
+        double s = run_threads(count, [&](uint32_t) {
+            std::vector<uint64_t> lat;
+            for(uint32_t i = 0; i != ops; ++i) {
+                uint64_t t = now();
+                m.lock();
+                if(!(i % sample))
+                    lat.push_back(now() - t);
+                ++counter;
+                m.unlock();
+            }
+            l.add(lat);
+        });
+        report(name + " " + std::to_string(count) + " threads", counter, s, l.all);
+    }
+
+    void bench_my_mutex()
+    {
+        for(uint32_t t: {1u, threads}) {
+            bench_lock<my_mutex>("my_mutex", t);
+            bench_lock<spin_mutex>("reference spin lock", t);
+        }
+    }
+}
+
+int main(int argc, char** argv)
+{
+    if(argc > 5) {
+        std::cout << "Usage: ./evie_bench [filter] [threads] [pin] [ops]" << std::endl;
+        return 1;
+    }
+    log_raii li("evie_bench.log", mlog::always_cout);
+    profilerinfo pff_info;
+    try {
+        if(argc > 1)
+            filter = argv[1];
+        if(argc > 2)
+            threads = lexical_cast<uint32_t>(argv[2]);
+        if(argc > 3)
+            pin = lexical_cast<bool>(argv[3]);
+        if(argc > 4)
+            ops = lexical_cast<uint32_t>(argv[4]);
+        mlog() << "evie_bench filter: " << filter << ", threads: " << threads << ", pin: " << pin << ", ops: " << ops
+            << ", cpus: " << std::thread::hardware_concurrency();
+
+        if(enabled("lockfree_queue")) {
+            bench_queues<8>();
+            bench_queues<64>();
+            bench_queues<256>();
+        }
+        if(enabled("fast_alloc")) {
+            bench_fast_alloc<64>();
+            bench_fast_alloc<12288>();
+            bench_fast_alloc_threads();
+        }
+        if(enabled("follower")) {
+            for(uint32_t r: {1u, threads}) {
+                bench_follower(r);
+                bench_shared_vector(r);
+            }
+        }
+        if(enabled("lockfree_list")) {
+            for(uint32_t p: {1u, threads}) {
+                bench_lockfree_list(p);
+                bench_mutex_list(p);
+            }
+        }
+        if(enabled("fmap"))
+            bench_fmap();
+        if(enabled("my_mutex"))
+            bench_my_mutex();
+    } catch(std::exception& e) {
+        mlog(mlog::error) << "evie_bench ended with " << e;
+        return 1;
+    }
+    return 0;
+}
@@ -1,283 +1,533 @@
-/*
-    author: Ilya Andronov <sni4ok@yandex.ru>
-*/
-
-#pragma once
-
-#include "profiler.hpp"
-
-#include <atomic>
-
-template<typename type, uint32_t size>
-struct array
-{
-    type elems[size];
-    type& operator[](uint32_t idx) {
-        return elems[idx];
-    }
-    const type& operator[](uint32_t idx) const {
-        return elems[idx];
-    }
-};
-
-//with follower can work one writer and many readers without synchronization
-template<typename type, uint32_t block_size = 16384, uint32_t num_blocks = 16384>
-class follower : noncopyable
-{
-    typedef array<type*, num_blocks> bulks_type;
-    bulks_type bulks;
-    std::atomic<uint32_t> num_elems;
-public:
-    typedef type value_type;
-
-    follower() : num_elems() {
-    }
-    ~follower() {
-        uint32_t elems = num_elems;
-        uint32_t end_bulk = elems / block_size;
-        uint32_t end_element = elems % block_size;
-        if(end_element)
-            ++end_bulk;
-        for(uint32_t i = 0; i != end_bulk; ++i)
-            delete[] bulks[i];
-    }
-    void push_back(const type& value) {
-        uint32_t elems = num_elems;
-        uint32_t end_bulk = elems / block_size;
-        uint32_t end_element = elems % block_size;
-
-        if(!end_element) {
-            MPROFILE("follower::new")
-            bulks[end_bulk] = new type[block_size];
-        }
-
-        (bulks[end_bulk])[end_element] = value;
-        ++num_elems;
-    }
-    class const_iterator :
-        public std::iterator<std::random_access_iterator_tag, type, int32_t>
-    {
-        const bulks_type* bulks;
-        uint32_t element;
-
-        friend class follower;
-
-        const type& dereference() const { 
-            uint32_t end_bulk = element / block_size;
-            uint32_t end_element = element % block_size;
-            return ((*bulks)[end_bulk])[end_element];
-        }
-        const_iterator(const bulks_type& bulks, uint32_t element) : bulks(&bulks), element(element){
-        }
-    public:
-        const_iterator(){}
-        bool operator==(const const_iterator& r) const {
-            return element == r.element;
-        }
-        bool operator!=(const const_iterator& r) const {
-            return element != r.element;
-        }
-        const_iterator& operator++() {
-            ++element;
-            return *this;
-        }
-        const_iterator& operator--() {
-            --element;
-            return *this;
-        }
-        const_iterator operator-(int32_t diff) const {
-            const_iterator ret(*bulks, element);
-            ret -= diff;
-            return ret;
-        }
-        const_iterator operator+(int32_t diff) const {
-            const_iterator ret(*bulks, element);
-            ret += diff;
-            return ret;
-        }
-        const_iterator& operator-=(int32_t diff) {
-            element -= diff;
-            return *this;
-        }
-        const_iterator& operator+=(int32_t diff) {
-            element += diff;
-            return *this;
-        }
-        int32_t operator-(const const_iterator& r) const {
-            return element - r.element;
-        }
-        const type& operator*() const {
-            return dereference();
-        }
-        const type* operator->() const {
-            const type& t = dereference();
-            return &t;
-        }
-    };
-    const_iterator begin() const {
-        return const_iterator(bulks, 0);
-    }
-    const_iterator end() const {
-        return const_iterator(bulks, num_elems);
-    }
-    const type& operator[](uint32_t idx) const {
-        return *(begin() + idx);
-    }
-    uint32_t size() const {
-        return num_elems;
-    }
-};
-
-template<typename type, uint32_t capacity_size>
-class lockfree_queue : noncopyable
-{
-    std::string name;
-    struct node
-    {
-        type elem;
-        //0 - empty and free
-        //1 - push lock
-        //2 - filled and free
-        //3 - pop lock
-        std::atomic<uint32_t> status;
-    };
-    array<node, capacity_size> elems;
-
-    std::atomic<uint64_t> push_cnt, pop_cnt;
-    static uint64_t get_idx(uint64_t idx) {
-        return idx % capacity_size;
-    }
-
-    //my_mutex mutex;
-    void throw_exception(const char* reason, uint32_t status)
-    {
-        throw std::runtime_error(es() % name % ":lockfree_queue:" % _str_holder(reason) % ", (" % capacity % "," % pop_cnt % "," % push_cnt % "," % status % ")");
-    }
-public:
-    lockfree_queue(const std::string& name) : name(name)
-    {
-    }
-    static constexpr uint32_t capacity = capacity_size;
-
-    void push(const type& t) {
-        push(type(t));
-    }
-    void push(type&& t) {
-        //my_mutex::scoped_lock lock(mutex);
-        node& n = elems[get_idx(push_cnt++)];
-        uint32_t status = 0;
-        if(!n.status.compare_exchange_strong(status, 1))
-            throw_exception("push() overloaded", status);
-        n.elem = std::move(t);
-        status = 1;
-        if(!n.status.compare_exchange_strong(status, 2))
-            throw_exception("push() internal error", status);
-    }
-    void pop_strong(type& t) {
-        //my_mutex::scoped_lock lock(mutex);
-        node& n = elems[get_idx(pop_cnt++)];
-        uint32_t status = 2;
-        if(!n.status.compare_exchange_strong(status, 3))
-            throw_exception("pop_strong() lock error", status);
-        t = std::move(n.elem);
-        status = 3;
-        if(!n.status.compare_exchange_strong(status, 0))
-            throw_exception("pop_strong() internal error", status);
-    }
-    bool pop_weak(type& t) {
-        //my_mutex::scoped_lock lock(mutex);
-        node& n = elems[get_idx(pop_cnt)];
-        uint32_t status = 2;
-        if(n.status.compare_exchange_strong(status, 3)) {
-            ++pop_cnt;
-            t = std::move(n.elem);
-            status = 3;
-            if(!n.status.compare_exchange_strong(status, 0))
-                throw_exception("pop_weak() internal error", status);
-            return true;
-        }
-        return false;
-    }
-};
-
-template<typename ttype, uint32_t pool_size = 16 * 1024>
-struct fast_alloc
-{
-    typedef ttype type;
-    lockfree_queue<type*, pool_size> elems;
-
-    fast_alloc(const std::string& name) : elems(name) {
-        for(uint32_t i = 0; i != pool_size; ++i)
-            elems.push(new type);
-    }
-    type* alloc() {
-        type* p;
-        elems.pop_strong(p);
-        return p;
-    }
-    void free(type* m) {
-        elems.push(m);
-    }
-    ~fast_alloc() {
-        type* p;
-        while(elems.pop_weak(p))
-            delete p;
-    }
-};
-
-template<typename alloc>
-class alloc_holder
-{
-    alloc &a;
-    typedef typename alloc::type type;
-    type* p;
-public:
-    alloc_holder(alloc& a) : a(a), p(a.alloc()) {
-    }
-    ~alloc_holder() {
-        if(p)
-            a.free(p);
-    }
-    type* operator->() {
-        return p;
-    }
-    type& operator*() {
-        return *p;
-    }
-    type* release() {
-        type* ret = p;
-        p = nullptr;
-        return ret;
-    }
-};
-
-template<typename type>
-struct lockfree_list
-{
-    struct node : type
-    {
-        node* next;
-        node() : next(){}
-    };
-    lockfree_list() : tail(&root) {
-    }
-    void push(node* t) {
-        node* expected = tail;
-        while(!tail.compare_exchange_weak(expected, t)) {
-            expected = tail;
-        }
-        expected->next = t;
-    }
-    node* begin() {
-        return root.next;
-    }
-    node* next(node* prev) {
-        if(!prev)
-            return root.next;
-        return prev->next;
-    }
-private:
-    node root;
-    std::atomic<node*> tail;
-};
-
+/*
+    author: Ilya Andronov <sni4ok@yandex.ru>
+*/
+
+#pragma once
+
+#include "profiler.hpp"
+#include "hugepages.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <sched.h>
+#include <memory>
+#include <vector>
+
+template<typename type, uint32_t size>
+struct array
+{
+    type elems[size];
+    type& operator[](uint32_t idx) {
+        return elems[idx];
+    }
+    const type& operator[](uint32_t idx) const {
+        return elems[idx];
+    }
+};
+
+//with follower can work one writer and many readers without synchronization
+template<typename type, uint32_t block_size = 16384, uint32_t num_blocks = 16384>
+class follower : noncopyable
+{
+    typedef array<type*, num_blocks> bulks_type;
+    bulks_type bulks;
+    std::atomic<uint32_t> num_elems;
+public:
+    typedef type value_type;
+
+    follower() : num_elems() {
+    }
+    ~follower() {
+        uint32_t elems = num_elems;
+        uint32_t end_bulk = elems / block_size;
+        uint32_t end_element = elems % block_size;
+        if(end_element)
+            ++end_bulk;
+        for(uint32_t i = 0; i != end_bulk; ++i)
+            delete[] bulks[i];
+    }
+    void push_back(const type& value) {
+        uint32_t elems = num_elems;
+        uint32_t end_bulk = elems / block_size;
+        uint32_t end_element = elems % block_size;
+
+        if(!end_element) {
+            MPROFILE("follower::new")
+            bulks[end_bulk] = new type[block_size];
+        }
+
+        (bulks[end_bulk])[end_element] = value;
+        ++num_elems;
+    }
+    class const_iterator :
+        public std::iterator<std::random_access_iterator_tag, type, int32_t>
+    {
+        const bulks_type* bulks;
+        uint32_t element;
+
+        friend class follower;
+
+        const type& dereference() const { 
+            uint32_t end_bulk = element / block_size;
+            uint32_t end_element = element % block_size;
+            return ((*bulks)[end_bulk])[end_element];
+        }
+        const_iterator(const bulks_type& bulks, uint32_t element) : bulks(&bulks), element(element){
+        }
+    public:
+        const_iterator(){}
+        bool operator==(const const_iterator& r) const {
+            return element == r.element;
+        }
+        bool operator!=(const const_iterator& r) const {
+            return element != r.element;
+        }
+        const_iterator& operator++() {
+            ++element;
+            return *this;
+        }
+        const_iterator& operator--() {
+            --element;
+            return *this;
+        }
+        const_iterator operator-(int32_t diff) const {
+            const_iterator ret(*bulks, element);
+            ret -= diff;
+            return ret;
+        }
+        const_iterator operator+(int32_t diff) const {
+            const_iterator ret(*bulks, element);
+            ret += diff;
+            return ret;
+        }
+        const_iterator& operator-=(int32_t diff) {
+            element -= diff;
+            return *this;
+        }
+        const_iterator& operator+=(int32_t diff) {
+            element += diff;
+            return *this;
+        }
+        int32_t operator-(const const_iterator& r) const {
+            return element - r.element;
+        }
+        const type& operator*() const {
+            return dereference();
+        }
+        const type* operator->() const {
+            const type& t = dereference();
+            return &t;
+        }
+    };
+    const_iterator begin() const {
+        return const_iterator(bulks, 0);
+    }
+    const_iterator end() const {
+        return const_iterator(bulks, num_elems);
+    }
+    const type& operator[](uint32_t idx) const {
+        return *(begin() + idx);
+    }
+    uint32_t size() const {
+        return num_elems;
+    }
+};
+
+template<typename type, uint32_t capacity_size>
+class lockfree_queue : noncopyable
+{
+    std::string name;
+    struct node
+    {
+        type elem;
+        //idx - free for push number idx
+        //idx + 1 - filled by push number idx
+        //node free again with idx + capacity after pop
+        std::atomic<uint64_t> seq;
+    };
+    array<node, capacity_size> elems;
+
+    std::atomic<uint64_t> push_cnt, pop_cnt;
+    static uint64_t get_idx(uint64_t idx) {
+        return idx % capacity_size;
+    }
+
+    //my_mutex mutex;
+    void throw_exception(const char* reason, uint64_t seq)
+    {
+        throw std::runtime_error(es() % name % ":lockfree_queue:" % _str_holder(reason) % ", (" % capacity % "," % pop_cnt % "," % push_cnt % "," % seq % ")");
+    }
+public:
+    lockfree_queue(const std::string& name) : name(name), push_cnt(), pop_cnt()
+    {
+        for(uint32_t i = 0; i != capacity_size; ++i)
+            elems[i].seq.store(i, std::memory_order_relaxed);
+    }
+    static constexpr uint32_t capacity = capacity_size;
+
+    void push(const type& t) {
+        push(type(t));
+    }
+    //push and pop numbers claimed only for ready nodes, so thread delayed inside of operation
+    //never meets node reused after queue wrapped, it only delays push to its node
+    void push(type&& t) {
+        //my_mutex::scoped_lock lock(mutex);
+        uint64_t idx = push_cnt;
+        for(;;) {
+            node& n = elems[get_idx(idx)];
+            uint64_t seq = n.seq.load(std::memory_order_acquire);
+            if(seq == idx) {
+                if(push_cnt.compare_exchange_weak(idx, idx + 1)) {
+                    n.elem = std::move(t);
+                    n.seq.store(idx + 1, std::memory_order_release);
+                    return;
+                }
+            }
+            else if(seq < idx) {
+                if(idx - pop_cnt >= capacity_size)
+                    throw_exception("push() overloaded", seq);
+                //node still popped by other thread
+                sched_yield();
+                idx = push_cnt;
+            }
+            else
+                idx = push_cnt;
+        }
+    }
+    //for queue with element, pushed before
+    void pop_strong(type& t) {
+        //my_mutex::scoped_lock lock(mutex);
+        uint64_t idx = pop_cnt++;
+        node& n = elems[get_idx(idx)];
+        uint64_t seq = n.seq.load(std::memory_order_acquire);
+        if(seq != idx + 1)
+            throw_exception("pop_strong() lock error", seq);
+        t = std::move(n.elem);
+        n.seq.store(idx + capacity_size, std::memory_order_release);
+    }
+    //fails for empty queue or while next element pushed
+    bool pop_weak(type& t) {
+        //my_mutex::scoped_lock lock(mutex);
+        uint64_t idx = pop_cnt;
+        for(;;) {
+            node& n = elems[get_idx(idx)];
+            uint64_t seq = n.seq.load(std::memory_order_acquire);
+            if(seq == idx + 1) {
+                if(pop_cnt.compare_exchange_weak(idx, idx + 1)) {
+                    t = std::move(n.elem);
+                    n.seq.store(idx + capacity_size, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if(seq < idx + 1)
+                return false;
+            else
+                idx = pop_cnt;
+        }
+    }
+    //no filled or being pushed elements
+    bool empty() const {
+        return pop_cnt >= push_cnt;
+    }
+};
+
+//pool with thread local magazines (loaded and previous) of mag_size elements,
+//alloc and free usually just move pointer in magazine of current thread,
+//full and empty magazines exchanged with shared depot by one queue operation per mag_size elements,
+//every thread cache adds 2 * mag_size elements to depot while thread alive, so magazines kept by threads not reduce pool,
+//with huge initial elements placed in one region of hugepages (see hugepages.hpp),
+//with grow new elements allocated when depot empty (up to (max_grow - 1) * pool_size) instead of throwing
+template<typename ttype, uint32_t pool_size = 16 * 1024>
+class fast_alloc : noncopyable
+{
+public:
+    typedef ttype type;
+    static constexpr uint32_t capacity = pool_size, mag_size = 32, max_grow = 4;
+
+private:
+    struct magazine
+    {
+        uint32_t count;
+        type* elems[mag_size];
+        magazine() : count()
+        {
+        }
+    };
+    typedef lockfree_queue<magazine*, max_grow * pool_size / mag_size + 1024> magazines;
+
+    //shared with thread caches, so threads ended after pool return elements to alive depot
+    struct depot : noncopyable
+    {
+        std::string name;
+        magazines full, empty;
+        type* region;
+        std::atomic<uint32_t> grown, owed;
+        bool grow;
+
+        depot(const std::string& name, bool huge, bool grow) : name(name), full(name + "_full"), empty(name + "_empty"),
+            region(), grown(), owed(), grow(grow)
+        {
+            if(huge)
+                region = (type*)huge_alloc(sizeof(type) * pool_size);
+            magazine* m = nullptr;
+            for(uint32_t i = 0; i != pool_size; ++i) {
+                if(!m)
+                    m = new magazine;
+                m->elems[m->count++] = huge ? new(region + i) type : new type;
+                if(m->count == mag_size) {
+                    full.push(m);
+                    m = nullptr;
+                }
+            }
+            if(m)
+                full.push(m);
+        }
+        //pop_weak also fails while other thread pushes to same slot or pops it, nullptr only for empty depot
+        magazine* pop_full()
+        {
+            magazine* m;
+            while(!full.empty()) {
+                if(full.pop_weak(m))
+                    return m;
+                sched_yield();
+            }
+            return nullptr;
+        }
+        //new magazine only when all of them kept by threads, so their number stays bounded
+        magazine* pop_empty()
+        {
+            magazine* m;
+            while(!empty.empty()) {
+                if(empty.pop_weak(m))
+                    return m;
+                sched_yield();
+            }
+            return new magazine;
+        }
+        type* grow_one()
+        {
+            if(!grow)
+                throw std::runtime_error(es() % name % ": fast_alloc pool of " % pool_size % " exhausted");
+            if(++grown > (max_grow - 1) * pool_size)
+                throw std::runtime_error(es() % name % ": fast_alloc grow limit " % grown % " exceed");
+            return new type;
+        }
+        //elements for magazines kept by new thread
+        void add_thread()
+        {
+            for(uint32_t i = 0; i != 2; ++i) {
+                magazine* m = new magazine;
+                for(; m->count != mag_size; ++m->count)
+                    m->elems[m->count] = new type;
+                full.push(m);
+            }
+        }
+        //ended thread returns its elements and 4 magazines (2 of them for elements, 2 created by cache),
+        //elements kept by other threads now owed and released by next ended thread
+        void remove_thread()
+        {
+            uint32_t left = 2 * mag_size + owed.exchange(0), magazines = 4;
+            while(left) {
+                magazine* m = pop_full();
+                if(!m)
+                    break;
+                //elements of region moved to front and released last, so heap ones leave pool first
+                std::partition(m->elems, m->elems + m->count, [this](type* p) {return in_region(p);});
+                for(; left && m->count; --left)
+                    release(m->elems[--m->count]);
+                if(m->count)
+                    full.push(m);
+                else if(magazines) {
+                    --magazines;
+                    delete m;
+                }
+                else
+                    empty.push(m);
+            }
+            owed += left;
+            magazine* m;
+            for(; magazines && empty.pop_weak(m); --magazines)
+                delete m;
+        }
+        bool in_region(type* p) const
+        {
+            return region && p >= region && p < region + pool_size;
+        }
+        void release(type* p)
+        {
+            if(in_region(p))
+                p->~type();
+            else
+                delete p;
+        }
+        ~depot()
+        {
+            magazine* m;
+            while(full.pop_weak(m)) {
+                for(uint32_t i = 0; i != m->count; ++i)
+                    release(m->elems[i]);
+                delete m;
+            }
+            while(empty.pop_weak(m))
+                delete m;
+            if(region)
+                huge_free(region, sizeof(type) * pool_size);
+        }
+    };
+
+    struct cache : noncopyable
+    {
+        std::shared_ptr<depot> d;
+        magazine *loaded, *previous;
+
+        cache(const std::shared_ptr<depot>& d) : d(d), loaded(new magazine), previous(new magazine)
+        {
+            d->add_thread();
+        }
+        void flush(magazine*& m)
+        {
+            if(m->count)
+                d->full.push(m);
+            else
+                d->empty.push(m);
+            m = new magazine;
+        }
+        ~cache()
+        {
+            try {
+                flush(loaded);
+                flush(previous);
+                d->remove_thread();
+            }
+            catch(std::exception& e) {
+                mlog(mlog::critical) << "~fast_alloc::cache() " << e;
+            }
+            delete loaded;
+            delete previous;
+        }
+    };
+    struct thread_caches
+    {
+        std::vector<std::unique_ptr<cache> > caches;
+        cache* last;
+        thread_caches() : last()
+        {
+        }
+    };
+    inline static thread_local thread_caches tcs;
+
+    std::shared_ptr<depot> d;
+
+    cache& get_cache()
+    {
+        thread_caches& t = tcs;
+        if(likely(t.last && t.last->d == d))
+            return *t.last;
+        for(auto& c: t.caches) {
+            if(c->d == d) {
+                t.last = c.get();
+                return *t.last;
+            }
+        }
+        t.caches.push_back(std::make_unique<cache>(d));
+        t.last = t.caches.back().get();
+        return *t.last;
+    }
+
+public:
+    fast_alloc(const std::string& name, bool huge = false, bool grow = false) : d(std::make_shared<depot>(name, huge, grow)) {
+    }
+    type* alloc() {
+        cache& c = get_cache();
+        if(likely(c.loaded->count))
+            return c.loaded->elems[--c.loaded->count];
+        if(c.previous->count)
+            std::swap(c.loaded, c.previous);
+        else {
+            magazine* m = d->pop_full();
+            if(unlikely(!m))
+                return d->grow_one();
+            d->empty.push(c.previous);
+            c.previous = c.loaded;
+            c.loaded = m;
+        }
+        return c.loaded->elems[--c.loaded->count];
+    }
+    void free(type* p) {
+        cache& c = get_cache();
+        if(likely(c.loaded->count != mag_size)) {
+            c.loaded->elems[c.loaded->count++] = p;
+            return;
+        }
+        if(!c.previous->count)
+            std::swap(c.loaded, c.previous);
+        else {
+            d->full.push(c.loaded);
+            c.loaded = d->pop_empty();
+        }
+        c.loaded->elems[c.loaded->count++] = p;
+    }
+    //returns magazines of current thread to depot, for threads only filled pool
+    void flush() {
+        cache& c = get_cache();
+        c.flush(c.loaded);
+        c.flush(c.previous);
+    }
+};
+
+template<typename alloc>
+class alloc_holder
+{
+    alloc &a;
+    typedef typename alloc::type type;
+    type* p;
+public:
+    alloc_holder(alloc& a) : a(a), p(a.alloc()) {
+    }
+    ~alloc_holder() {
+        if(p)
+            a.free(p);
+    }
+    type* operator->() {
+        return p;
+    }
+    type& operator*() {
+        return *p;
+    }
+    type* release() {
+        type* ret = p;
+        p = nullptr;
+        return ret;
+    }
+};
+
+template<typename type>
+struct lockfree_list
+{
+    struct node : type
+    {
+        node* next;
+        node() : next(){}
+    };
+    lockfree_list() : tail(&root) {
+    }
+    void push(node* t) {
+        node* expected = tail;
+        while(!tail.compare_exchange_weak(expected, t)) {
+            expected = tail;
+        }
+        expected->next = t;
+    }
+    node* begin() {
+        return root.next;
+    }
+    node* next(node* prev) {
+        if(!prev)
+            return root.next;
+        return prev->next;
+    }
+private:
+    node root;
+    std::atomic<node*> tail;
+};
+
@@ -6,6 +6,8 @@
 
 #include "vector.hpp"
 
+#include <algorithm>
+
 template<typename key, typename value>
 struct fmap
 {
@@ -0,0 +1,49 @@
+/*
+    anonymous memory on 2MB pages, reserved hugepages (MAP_HUGETLB) if available,
+    else 2MB aligned region with transparent hugepages advice, pages populated at allocation
+
+    author: Ilya Andronov <sni4ok@yandex.ru>
+*/
+
+#pragma once
+
+#include "utils.hpp"
+#include "mlog.hpp"
+
+#include <sys/mman.h>
+
+static const uint64_t huge_page_size = 2 * 1024 * 1024;
+
+inline uint64_t huge_round(uint64_t size)
+{
+    return (size + huge_page_size - 1) / huge_page_size * huge_page_size;
+}
+
+inline void* huge_alloc(uint64_t size)
+{
+    size = huge_round(size);
+    void* p = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | MAP_POPULATE, -1, 0);
+    if(p != MAP_FAILED)
+        return p;
+
+    mlog(mlog::warning) << "huge_alloc() no reserved hugepages for " << size << " bytes, transparent hugepages used";
+    p = mmap(NULL, size + huge_page_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if(p == MAP_FAILED)
+        throw_system_failure(es() % "huge_alloc() mmap error for " % size % " bytes");
+    char* b = (char*)p, *a = (char*)huge_round(uint64_t(b)), *e = b + size + huge_page_size;
+    if(a != b)
+        munmap(b, a - b);
+    if(a + size != e)
+        munmap(a + size, e - (a + size));
+    if(madvise(a, size, MADV_HUGEPAGE))
+        mlog(mlog::warning) << "huge_alloc() madvise(MADV_HUGEPAGE) error";
+    for(uint64_t i = 0; i < size; i += 4096)
+        a[i] = 0;
+    return a;
+}
+
+inline void huge_free(void* p, uint64_t size)
+{
+    munmap(p, huge_round(size));
+}
+
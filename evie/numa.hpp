@@ -0,0 +1,54 @@
+/*
+    numa placement without libnuma, cpus of node read from sysfs,
+    linux places memory page on node of first touching thread,
+    so memory allocated and filled by thread bound to node stays local for it
+
+    author: Ilya Andronov <sni4ok@yandex.ru>
+*/
+
+#pragma once
+
+#include "mfile.hpp"
+#include "mlog.hpp"
+
+#include <pthread.h>
+#include <sched.h>
+
+//cpus of numa node, empty if node not exists
+inline std::vector<uint32_t> numa_node_cpus(uint32_t node)
+{
+    std::string s = read_file<std::string>((std::string("/sys/devices/system/node/node") + std::to_string(node) + "/cpulist").c_str(), true);
+    std::vector<uint32_t> ret;
+    while(!s.empty() && (s.back() == '\n' || s.back() == ' '))
+        s.pop_back();
+    if(s.empty())
+        return ret;
+    for(const std::string& r: split(s, ',')) {
+        auto i = std::find(r.begin(), r.end(), '-');
+        uint32_t from = lexical_cast<uint32_t>(std::string(r.begin(), i));
+        uint32_t to = (i == r.end()) ? from : lexical_cast<uint32_t>(std::string(i + 1, r.end()));
+        for(; from <= to; ++from)
+            ret.push_back(from);
+    }
+    return ret;
+}
+
+//binds current thread to cpus of node, on single node machines and wrong nodes affinity kept
+inline bool numa_bind_thread(uint32_t node)
+{
+    std::vector<uint32_t> cpus = numa_node_cpus(node);
+    if(cpus.empty()) {
+        mlog(mlog::warning) << "numa_bind_thread() node " << node << " not found, thread not bound";
+        return false;
+    }
+    cpu_set_t cpuset;
+    CPU_ZERO(&cpuset);
+    for(uint32_t c: cpus)
+        CPU_SET(c, &cpuset);
+    if(pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpuset)) {
+        mlog(mlog::critical) << "numa_bind_thread() pthread_setaffinity_np() error for node " << node;
+        return false;
+    }
+    return true;
+}
+
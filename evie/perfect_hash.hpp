@@ -0,0 +1,156 @@
+/*
+    collision free hash for small sets of short strings known at startup (tickers, channels)
+    hash and displace scheme: first hash selects bucket with displacement,
+    second hash with displacement selects unique slot, so lookup is two multiplies and one compare
+
+    author: Ilya Andronov <sni4ok@yandex.ru>
+*/
+
+#pragma once
+
+#include "string.hpp"
+
+#include <vector>
+#include <algorithm>
+
+template<typename value, uint32_t key_size = 16>
+class perfect_hash
+{
+public:
+    typedef my_basic_string<char, key_size> key;
+    struct node
+    {
+        key first;
+        value second;
+    };
+
+private:
+    std::vector<node> table;
+    std::vector<uint32_t> disp;
+    uint32_t shift, bmask, count;
+
+    static const uint64_t mult = 0x9E3779B97F4A7C15ull;
+    static const uint32_t max_disp = 64 * 1024;
+
+    static uint64_t load(const char* p, uint32_t sz) {
+        uint64_t v = 0;
+        memcpy(&v, p, sz);
+        return v;
+    }
+    static uint64_t hash(const char* s, uint32_t sz) {
+        uint64_t h = sz;
+        for(; sz >= 8; s += 8, sz -= 8)
+            h = (h ^ load(s, 8)) * mult;
+        if(sz)
+            h = (h ^ load(s, sz)) * mult;
+        return h ^ (h >> 29);
+    }
+    uint32_t slot(uint64_t h, uint32_t d) const {
+        h = (h + d * mult) * 0xBF58476D1CE4E5B9ull;
+        return h >> shift;
+    }
+    bool place(std::vector<node>& nodes, uint32_t bits)
+    {
+        uint32_t size = 1 << bits, buckets = std::max<uint32_t>(1, size / 4);
+        shift = 64 - bits;
+        bmask = buckets - 1;
+        std::vector<node> t(size);
+        std::vector<uint32_t> ds(buckets);
+        std::vector<std::vector<uint32_t> > bs(buckets);
+        for(uint32_t i = 0; i != nodes.size(); ++i) {
+            const key& k = nodes[i].first;
+            bs[hash(k.begin(), k.size()) & bmask].push_back(i);
+        }
+        std::vector<uint32_t> order(buckets);
+        for(uint32_t i = 0; i != buckets; ++i)
+            order[i] = i;
+        std::sort(order.begin(), order.end(), [&bs](uint32_t l, uint32_t r) {return bs[l].size() > bs[r].size();});
+
+        std::vector<uint32_t> slots;
+        for(uint32_t b: order) {
+            const std::vector<uint32_t>& bk = bs[b];
+            if(bk.empty())
+                break;
+            uint32_t d = 0;
+            for(; d != max_disp; ++d) {
+                slots.clear();
+                for(uint32_t i: bk) {
+                    const key& k = nodes[i].first;
+                    uint32_t s = slot(hash(k.begin(), k.size()), d);
+                    if(!t[s].first.empty() || std::find(slots.begin(), slots.end(), s) != slots.end())
+                        break;
+                    slots.push_back(s);
+                }
+                if(slots.size() == bk.size())
+                    break;
+            }
+            if(d == max_disp)
+                return false;
+            ds[b] = d;
+            for(uint32_t i = 0; i != bk.size(); ++i)
+                t[slots[i]] = nodes[bk[i]];
+        }
+        table.swap(t);
+        disp.swap(ds);
+        return true;
+    }
+    void rebuild(std::vector<node>& nodes)
+    {
+        uint32_t bits = 2;
+        while((1u << bits) < nodes.size() * 2)
+            ++bits;
+        for(; bits != 24; ++bits) {
+            if(place(nodes, bits)) {
+                count = nodes.size();
+                return;
+            }
+        }
+        throw std::runtime_error(es() % "perfect_hash::rebuild() failed for " % nodes.size() % " keys");
+    }
+
+public:
+    perfect_hash() : count()
+    {
+        std::vector<node> nodes;
+        rebuild(nodes);
+    }
+    uint32_t size() const {
+        return count;
+    }
+    //slow path, rebuilds table, values and pointers from find() not preserved
+    void insert(str_holder k, const value& v)
+    {
+        if(unlikely(!k.size))
+            throw std::runtime_error("perfect_hash::insert() empty key");
+        value* p = find(k.str, k.size);
+        if(p) {
+            *p = v;
+            return;
+        }
+        std::vector<node> nodes;
+        nodes.reserve(count + 1);
+        for(const node& n: table) {
+            if(!n.first.empty())
+                nodes.push_back(n);
+        }
+        nodes.push_back(node{key(k), v});
+        rebuild(nodes);
+    }
+    void insert(const std::string& k, const value& v)
+    {
+        insert(str_holder(k.c_str(), k.size()), v);
+    }
+    value* find(const char* s, uint32_t sz)
+    {
+        uint64_t h = hash(s, sz);
+        node& n = table[slot(h, disp[h & bmask])];
+        if(likely(n.first.size() == sz && sz && std::equal(s, s + sz, n.first.begin())))
+            return &n.second;
+        return nullptr;
+    }
+    value* find(str_holder k)
+    {
+        return find(k.str, k.size);
+    }
+};
+
@@ -0,0 +1,303 @@
+/*
+    compact encoding of tyra streams, enabled by compact param of tyra sender,
+    stream started with msg_compact message, after it every message encoded as tag byte and varint fields:
+    time as zigzag delta from previous message, etime, price, level_id and count
+    as zigzag deltas from previous message of same security,
+    messages of other types or with not zero padding sent as is after raw tag
+
+    author: Ilya Andronov <sni4ok@yandex.ru>
+*/
+
+#pragma once
+
+#include "messages.hpp"
+
+#include "evie/utils.hpp"
+
+#include <cstring>
+
+namespace compact
+{
+    //max encoded size of one message
+    static const uint32_t max_size = 64;
+
+    enum
+    {
+        raw = 0,
+        book = 1,
+        trade = 2,
+        seq = 3,
+        type_mask = 7,
+
+        same_security = 8,
+        //book only
+        level_price = 16,
+        //trade only, direction in bits 4-5
+        direction_shift = 4
+    };
+
+    inline char* put(char* p, uint64_t v)
+    {
+        while(v >= 0x80) {
+            *p++ = char(v | 0x80);
+            v >>= 7;
+        }
+        *p++ = char(v);
+        return p;
+    }
+
+    inline char* put_delta(char* p, uint64_t v, uint64_t prev)
+    {
+        int64_t d = int64_t(v - prev);
+        return put(p, (uint64_t(d) << 1) ^ uint64_t(d >> 63));
+    }
+
+    //returns nullptr if [p, e) ends before value
+    inline const char* get(const char* p, const char* e, uint64_t& v)
+    {
+        v = 0;
+        for(uint32_t s = 0; p != e; s += 7) {
+            if(unlikely(s > 63))
+                throw std::runtime_error("compact::get() bad varint");
+            uint8_t c = *p++;
+            v |= uint64_t(c & 0x7f) << s;
+            if(!(c & 0x80))
+                return p;
+        }
+        return nullptr;
+    }
+
+    inline const char* get_delta(const char* p, const char* e, uint64_t& v, uint64_t prev)
+    {
+        uint64_t z;
+        p = get(p, e, z);
+        v = prev + ((z >> 1) ^ (0 - (z & 1)));
+        return p;
+    }
+
+    inline bool zero(const void* p, uint32_t size)
+    {
+        const uint8_t* i = (const uint8_t*)p, *e = i + size;
+        for(; i != e; ++i)
+            if(*i)
+                return false;
+        return true;
+    }
+
+    //previous values of security, slots are direct mapped by security_id,
+    //on collision slot reset, encoder and decoder see same messages and agree on this
+    struct security_state
+    {
+        uint32_t security_id;
+        uint64_t etime, price, level_id, count;
+    };
+
+    class state
+    {
+        static const uint32_t slots = 1024;
+        security_state securities[slots];
+
+    protected:
+        uint64_t time, seq_end;
+        uint32_t security_id;
+
+        state() : securities(), time(), seq_end(), security_id()
+        {
+        }
+        security_state get_security(uint32_t id) const
+        {
+            const security_state& s = securities[id % slots];
+            if(likely(s.security_id == id))
+                return s;
+            security_state r = security_state();
+            r.security_id = id;
+            return r;
+        }
+        void set_security(const security_state& s)
+        {
+            securities[s.security_id % slots] = s;
+            security_id = s.security_id;
+        }
+    };
+
+    class encoder : state
+    {
+        char* put_security(char* p, uint8_t& tag, uint32_t id)
+        {
+            if(id == security_id) {
+                tag |= same_security;
+                return p;
+            }
+            memcpy(p, &id, sizeof(id));
+            return p + sizeof(id);
+        }
+
+    public:
+        //writes at most max_size bytes
+        char* encode(const message& m, char* p)
+        {
+            char* t = p++;
+            uint8_t tag = raw;
+            if(m.id.id == msg_book && zero(m.mb.unused, sizeof(m.mb.unused))) {
+                const message_book& b = m.mb;
+                tag = book;
+                security_state s = get_security(b.security_id);
+                p = put_security(p, tag, b.security_id);
+                p = put_delta(p, b.time.value, time);
+                p = put_delta(p, b.etime.value, s.etime);
+                p = put_delta(p, b.price.value, s.price);
+                if(b.level_id == b.price.value)
+                    tag |= level_price;
+                else {
+                    p = put_delta(p, b.level_id, s.level_id);
+                    s.level_id = b.level_id;
+                }
+                p = put_delta(p, b.count.value, s.count);
+                s.etime = b.etime.value;
+                s.price = b.price.value;
+                s.count = b.count.value;
+                set_security(s);
+            }
+            else if(m.id.id == msg_trade && !m.mt.unused && !m.mt.unused_ && m.mt.direction < 4) {
+                const message_trade& tr = m.mt;
+                tag = trade | (tr.direction << direction_shift);
+                security_state s = get_security(tr.security_id);
+                p = put_security(p, tag, tr.security_id);
+                p = put_delta(p, tr.time.value, time);
+                p = put_delta(p, tr.etime.value, s.etime);
+                p = put_delta(p, tr.price.value, s.price);
+                p = put_delta(p, tr.count.value, s.count);
+                s.etime = tr.etime.value;
+                s.price = tr.price.value;
+                s.count = tr.count.value;
+                set_security(s);
+            }
+            else if(m.id.id == msg_seq && !m.ms.etime.value && zero(m.ms.unused, sizeof(m.ms.unused)) && !m.ms.unused_) {
+                const message_seq& sq = m.ms;
+                tag = seq;
+                p = put_delta(p, sq.time.value, time);
+                p = put_delta(p, sq.seq, seq_end);
+                p = put(p, sq.count);
+                p = put(p, sq.flags);
+                seq_end = sq.seq + sq.count;
+            }
+            else {
+                memcpy(p, &m, message_size);
+                p += message_size;
+            }
+            time = m.t.time.value;
+            *t = char(tag);
+            return p;
+        }
+        //out should have count * max_size bytes, returns encoded size
+        uint32_t encode(const message* m, uint32_t count, char* out)
+        {
+            char* p = out;
+            for(const message* e = m + count; m != e; ++m)
+                p = encode(*m, p);
+            return p - out;
+        }
+    };
+
+    class decoder : state
+    {
+        const char* get_security(const char* p, const char* e, uint8_t tag, security_state& s) const
+        {
+            uint32_t id = security_id;
+            if(!(tag & same_security)) {
+                if(uint64_t(e - p) < sizeof(id))
+                    return nullptr;
+                memcpy(&id, p, sizeof(id));
+                p += sizeof(id);
+            }
+            s = state::get_security(id);
+            return p;
+        }
+
+    public:
+        //decodes one message from [p, e), returns nullptr and keeps state if message not complete
+        const char* decode(const char* p, const char* e, message& m)
+        {
+            if(p == e)
+                return nullptr;
+            uint8_t tag = *p++;
+            uint32_t type = tag & type_mask;
+            uint64_t t;
+            if(type == book || type == trade) {
+                security_state s;
+                uint64_t etime, price, level_id = 0, count;
+                if(!(p = get_security(p, e, tag, s)) || !(p = get_delta(p, e, t, time)) || !(p = get_delta(p, e, etime, s.etime))
+                    || !(p = get_delta(p, e, price, s.price)))
+                    return nullptr;
+                if(type == book && !(tag & level_price) && !(p = get_delta(p, e, level_id, s.level_id)))
+                    return nullptr;
+                if(!(p = get_delta(p, e, count, s.count)))
+                    return nullptr;
+                s.etime = etime;
+                s.price = price;
+                s.count = count;
+                m = message();
+                if(type == book) {
+                    message_book& b = m.mb;
+                    b.id = msg_book;
+                    if(tag & level_price)
+                        level_id = price;
+                    else
+                        s.level_id = level_id;
+                    b.security_id = s.security_id;
+                    b.level_id = level_id;
+                    b.price.value = price;
+                    b.count.value = count;
+                }
+                else {
+                    message_trade& tr = m.mt;
+                    tr.id = msg_trade;
+                    tr.direction = (tag >> direction_shift) & 3;
+                    tr.security_id = s.security_id;
+                    tr.price.value = price;
+                    tr.count.value = count;
+                }
+                m.t.time.value = t;
+                m.t.etime.value = etime;
+                set_security(s);
+            }
+            else if(type == seq) {
+                uint64_t sq, count, flags;
+                if(!(p = get_delta(p, e, t, time)) || !(p = get_delta(p, e, sq, seq_end)) || !(p = get(p, e, count))
+                    || !(p = get(p, e, flags)))
+                    return nullptr;
+                m = message();
+                message_seq& s = m.ms;
+                s.time.value = t;
+                s.id = msg_seq;
+                s.seq = sq;
+                s.count = count;
+                s.flags = flags;
+                seq_end = sq + count;
+            }
+            else if(type == raw) {
+                if(uint64_t(e - p) < message_size)
+                    return nullptr;
+                memcpy(&m, p, message_size);
+                p += message_size;
+            }
+            else
+                throw std::runtime_error(es() % "compact::decoder::decode() bad tag: " % uint32_t(tag));
+            time = m.t.time.value;
+            return p;
+        }
+        //decodes max count messages, moves p to first not decoded byte
+        uint32_t decode(const char*& p, const char* e, message* m, uint32_t count)
+        {
+            uint32_t c = 0;
+            for(; c != count; ++c) {
+                const char* n = decode(p, e, m[c]);
+                if(!n)
+                    break;
+                p = n;
+            }
+            return c;
+        }
+    };
+}
+
@@ -15,8 +15,19 @@ config::config(const char* fname)
     imports = get_config_params<std::string>(cs, "import");
     exports = get_config_params<std::string>(cs, "export");
     export_threads = get_config_param<uint32_t>(cs, "export_threads");
+    shards = get_config_param<uint32_t>(cs, "shards", true, 1);
+    if(!shards)
+        throw std::runtime_error("config::config() zero shards");
+    for(const std::string& n: split(get_config_param<std::string>(cs, "shard_nodes", true), ' ')) {
+        if(!n.empty())
+            shard_nodes.push_back(lexical_cast<uint32_t>(n));
+    }
+    if(!shard_nodes.empty() && shard_nodes.size() != shards)
+        throw std::runtime_error(es() % "config::config() shard_nodes should have node for every of " % shards % " shards");
 
     pooling = get_config_param<bool>(cs, "pooling");
+    hugepages = get_config_param<bool>(cs, "hugepages", true);
+    pool_grow = get_config_param<bool>(cs, "pool_grow", true);
 }
 
 void config::print()
@@ -31,6 +42,15 @@ void config::print()
     for(auto v: exports)
         ml << "      " << v << "\n";
     ml << "  export_threads: " << export_threads << "\n"
-        << "  pooling: " << pooling << "\n";
+        << "  shards: " << shards << "\n";
+    if(!shard_nodes.empty()) {
+        ml << "  shard_nodes:";
+        for(auto v: shard_nodes)
+            ml << " " << v;
+        ml << "\n";
+    }
+    ml << "  pooling: " << pooling << "\n"
+        << "  hugepages: " << hugepages << "\n"
+        << "  pool_grow: " << pool_grow << "\n";
 }
 
@@ -15,8 +15,16 @@ struct config : stack_singleton<config>
     std::vector<std::string> imports;
     std::vector<std::string> exports;
     uint32_t export_threads;
+    //imports distributed by shards in config order, every shard has own messages list
+    uint32_t shards;
+    //numa node for every shard, its pool, importers and exporters bound to node, empty for no binding
+    std::vector<uint32_t> shard_nodes;
 
     bool pooling;
+    //engine messages pools on hugepages
+    bool hugepages;
+    //engine messages pools grow under burst instead of error
+    bool pool_grow;
     config(const char* fname);
     void print();
 };
@@ -10,8 +10,10 @@
 #include "evie/fast_alloc.hpp"
 #include "evie/mlog.hpp"
 #include "evie/time.hpp"
+#include "evie/numa.hpp"
 
 #include <vector>
+#include <unordered_map>
 #include <thread>
 #include <mutex>
 #include <condition_variable>
@@ -20,6 +22,9 @@
 
 bool pooling_mode = false;
 
+//shard of contexts created by current import thread
+thread_local uint32_t import_shard = 0;
+
 struct messages
 {
     messages()
@@ -45,7 +50,7 @@ class linked_list : public fast_alloc<linked_node, 4 * 1024>
     std::atomic<linked_node*> tail;
     
 public:
-    linked_list() : fast_alloc("messages_linked_list"), tail(&root)
+    linked_list(bool huge, bool grow) : fast_alloc("messages_linked_list", huge, grow), tail(&root)
     {
     }
     void push(linked_node* t) //push element in list, always success
@@ -133,6 +138,12 @@ public:
         last_value = &(*it);
         return *last_value;
     }
+    bool active(uint32_t security_id)
+    {
+        tmp.security_id = security_id;
+        auto it = std::lower_bound(data.begin(), data.end(), tmp);
+        return it != data.end() && it->security_id == security_id && !it->disconnected;
+    }
     type& get(uint32_t security_id)
     {
         if(last_value && last_value->security_id == security_id)
@@ -146,17 +157,91 @@ public:
         last_value = &(*it);
         return *last_value;
     }
-    void on_disconnect();
+    void on_disconnect(uint32_t shard);
+};
+
+//sequence numbers from tyra senders with retransmit window, pipe and mmap_cp, batches out of order
+//dropped until sender replays them from expected, senders without replay closed on gap by reader
+struct sequence
+{
+    uint64_t expected, gaps, duplicates;
+    uint32_t left, drop;
+    bool active, requested, request;
+
+    sequence() : expected(), gaps(), duplicates(), left(), drop(), active(), requested(), request()
+    {
+    }
+    //removes envelopes and unexpected messages in place, returns new count
+    uint32_t filter(message* m, uint32_t count)
+    {
+        message* to = m;
+        for(message* i = m, *e = m + count; i != e; ++i) {
+            if(left) {
+                --left;
+                if(drop) {
+                    --drop;
+                    continue;
+                }
+                ++expected;
+            }
+            else if(i->id == msg_seq) {
+                const message_seq& s = i->ms;
+                if(unlikely(s.flags & seq_reset))
+                    throw std::runtime_error(es() % "sequence " % expected % " out of sender retransmit window, sender seq: " % s.seq);
+                if(!active) {
+                    active = true;
+                    expected = s.seq;
+                }
+                left = s.count;
+                if(s.seq <= expected) {
+                    drop = std::min<uint64_t>(expected - s.seq, s.count);
+                    if(drop)
+                        ++duplicates;
+                    if(drop != s.count)
+                        requested = false;
+                }
+                else {
+                    drop = s.count;
+                    if(!requested) {
+                        mlog(mlog::warning) << "sequence gap, expected: " << expected << ", received: " << s.seq;
+                        ++gaps;
+                        requested = true;
+                        request = true;
+                    }
+                }
+                continue;
+            }
+            if(to != i)
+                *to = *i;
+            ++to;
+        }
+        return to - m;
+    }
+};
+
+struct arbiter;
+
+//exchange time and order number within same exchange time of last message for security
+struct arb_key
+{
+    ttime_t etime;
+    uint32_t idx;
 };
 
 struct context
 {
     actives acs;
+    sequence seq;
+    uint32_t shard;
+
+    //feed of arbitrated import, messages checked in shared arbiter context
+    arbiter* arb;
+    uint32_t feed;
+    std::unordered_map<uint32_t, arb_key> keys;
+    uint64_t wins, duplicates, lag, lags;
 
     uint32_t buf_delta;
-    context() : buf_delta()
-    {
-    }
+    context(arbiter* arb = nullptr);
     void insert(uint32_t security_id, ttime_t time)
     {
         acs.insert(security_id).time = time;
@@ -175,25 +260,201 @@ struct context
         if(mc.source == 1)
             v.disconnected = true;
     }
-    ~context()
+    ~context();
+};
+
+//first arrival arbitration between redundant feeds with same instruments,
+//messages keyed by exchange time and order within it, so feeds should fill etime,
+//books cleaned only when last feed disconnected.
+//messages without etime can't be matched between feeds, until security has keyed messages
+//it taken from one owner feed, after owner disconnect security cleaned and taken from
+//next feed starting with its clean (snapshot)
+struct arbiter : noncopyable
+{
+    struct emitted : arb_key
     {
-        try{
-            acs.on_disconnect();
+        ttime_t time; //local arrival
+        ttime_t ptime; //parser time, kept monotonic for security
+        uint32_t owner; //feed of messages without etime
+        bool released; //owner disconnected, next one should start from clean
+    };
+
+    std::string name;
+    std::mutex mutex;
+    context* ctx;
+    std::unordered_map<uint32_t, emitted> keys;
+    uint32_t feeds, connected, leader, shard;
+    uint64_t switches;
+
+    //all feeds pushed to shard of import created arbiter
+    arbiter(const char* name) : name(name), ctx(), feeds(), connected(), leader(), shard(import_shard), switches()
+    {
+    }
+    void connect(context& f)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        f.feed = ++feeds;
+        if(!connected++) {
+            ctx = new context();
+            ctx->shard = shard;
         }
-        catch(std::exception& e){
-            mlog() << "~context() " << e;
+        mlog() << "arbiter " << name << " feed " << f.feed << " connected, feeds: " << connected;
+    }
+    void disconnect(context& f);
+    uint32_t security(const message& m)
+    {
+        if(m.id == msg_book)
+            return m.mb.security_id;
+        if(m.id == msg_trade)
+            return m.mt.security_id;
+        return m.mc.security_id;
+    }
+    //removes already emitted by other feeds messages in place, returns new count
+    uint32_t filter(context& f, message* m, uint32_t count)
+    {
+        ttime_t now = get_cur_ttime();
+        message* to = m;
+        for(message* i = m, *e = m + count; i != e; ++i) {
+            uint8_t id = i->id.id;
+            if((id == msg_book || id == msg_trade || id == msg_clean) && !i->t.etime.value) {
+                emitted& em = keys[security(*i)];
+                //after keyed messages ones without etime are late snapshots of other feeds
+                if(!em.etime.value && !em.owner && (id == msg_clean || !em.released))
+                    em.owner = f.feed;
+                if(em.etime.value || em.owner != f.feed) {
+                    ++f.duplicates;
+                    continue;
+                }
+                if(i->t.time < em.ptime)
+                    i->t.time = em.ptime;
+                em.ptime = i->t.time;
+                ++f.wins;
+            }
+            else if(id == msg_book || id == msg_trade || id == msg_clean) {
+                uint32_t security_id = security(*i);
+                arb_key& k = f.keys[security_id];
+                if(k.etime.value == i->t.etime.value)
+                    ++k.idx;
+                else {
+                    k.etime = i->t.etime;
+                    k.idx = 1;
+                }
+                emitted& em = keys[security_id];
+                if(em.etime < k.etime || (em.etime.value == k.etime.value && em.idx < k.idx)) {
+                    static_cast<arb_key&>(em) = k;
+                    em.time = now;
+                    if(i->t.time < em.ptime)
+                        i->t.time = em.ptime;
+                    em.ptime = i->t.time;
+                    if(leader != f.feed) {
+                        if(leader)
+                            ++switches;
+                        leader = f.feed;
+                    }
+                    ++f.wins;
+                }
+                else {
+                    if(em.etime.value == k.etime.value && em.idx == k.idx) {
+                        f.lag += now.value - em.time.value;
+                        ++f.lags;
+                    }
+                    ++f.duplicates;
+                    continue;
+                }
+            }
+            else if(id == msg_instr) {
+                if(ctx->acs.active(i->mi.security_id)) {
+                    ++f.duplicates;
+                    continue;
+                }
+                emitted& em = keys[i->mi.security_id];
+                if(em.ptime < i->mi.time)
+                    em.ptime = i->mi.time;
+            }
+            if(to != i)
+                *to = *i;
+            ++to;
         }
+        return to - m;
+    }
+    ~arbiter()
+    {
+        delete ctx;
     }
 };
 
+context::context(arbiter* arb) : shard(arb ? arb->shard : import_shard), arb(arb), feed(), wins(), duplicates(), lag(), lags(), buf_delta()
+{
+    if(arb)
+        arb->connect(*this);
+}
+
+context::~context()
+{
+    if(seq.active)
+        mlog() << "~context() sequence: " << seq.expected << ", gaps: " << seq.gaps << ", duplicates: " << seq.duplicates;
+    if(arb)
+        arb->disconnect(*this);
+    try{
+        acs.on_disconnect(shard);
+    }
+    catch(std::exception& e){
+        mlog() << "~context() " << e;
+    }
+}
+
 class engine::impl : public stack_singleton<engine::impl>
 {
     volatile bool& can_run;
     std::mutex mutex;
     std::condition_variable cond;
     std::vector<std::thread> threads;
-    linked_list ll;
-    uint32_t consumers;
+
+    //own messages list for group of imports, so importers of different shards not contend on one list tail
+    struct shard
+    {
+        linked_list ll;
+        uint32_t consumers, group;
+
+        shard() : ll(config::instance().hugepages, config::instance().pool_grow), consumers(), group()
+        {
+        }
+        //touches all nodes of pool, so their pages placed on numa node of current thread
+        void prefault()
+        {
+            std::vector<linked_node*> nodes;
+            for(uint32_t i = 0; i != ll.capacity; ++i) {
+                nodes.push_back(ll.alloc());
+                memset((void*)nodes.back()->m, 0, sizeof(nodes.back()->m));
+            }
+            for(linked_node* n: nodes)
+                ll.free(n);
+            ll.flush();
+        }
+    };
+    std::vector<std::unique_ptr<shard> > shards;
+
+    //pool of shard created by thread bound to numa node of shard importers
+    static shard* create_shard(uint32_t node)
+    {
+        shard* s = nullptr;
+        std::string error;
+        std::thread t([&s, &error, node]() {
+            try {
+                numa_bind_thread(node);
+                std::unique_ptr<shard> p = std::make_unique<shard>();
+                p->prefault();
+                s = p.release();
+            }
+            catch(std::exception& e) {
+                error = e.what();
+            }
+        });
+        t.join();
+        if(!s)
+            throw std::runtime_error(es() % "engine::create_shard() for node " % node % " error: " % error);
+        return s;
+    }
 
     void notify()
     {
@@ -214,21 +475,19 @@ class engine::impl : public stack_singleton<engine::impl>
         }
     }
 
-    struct imple
+    //position of exporter in messages list of one shard
+    struct cursor
     {
         linked_list* ll;
-        exporter exp;
-        linked_list::type *prev, *ptmp;
-        imple()
-        {
-        }
-        imple(linked_list& ll, const std::string& eparams) : ll(&ll), exp(eparams), prev(), ptmp()
+        linked_list::type *prev;
+
+        cursor(linked_list& ll) : ll(&ll), prev()
         {
         }
-        bool proceed()
+        bool proceed(exporter& exp)
         {
             bool ret = false;
-            ptmp = ll->next(prev);
+            linked_list::type* ptmp = ll->next(prev);
             while(ptmp){
                 exp.proceed(ptmp->m, ptmp->count);
                 ret = true;
@@ -239,7 +498,7 @@ class engine::impl : public stack_singleton<engine::impl>
             }
             return ret;
         }
-        ~imple()
+        void release()
         {
             try {
                 if(prev)
@@ -250,10 +509,45 @@ class engine::impl : public stack_singleton<engine::impl>
             }
         }
     };
-    lockfree_queue<imple*, 50> ies;
+    //exporter reads one shard or all of them in turn (order kept only within shard)
+    struct imple
+    {
+        exporter exp;
+        std::vector<cursor> cursors;
+
+        imple(const std::string& eparams) : exp(eparams)
+        {
+        }
+        bool proceed()
+        {
+            bool ret = false;
+            for(cursor& c: cursors)
+                ret |= c.proceed(exp);
+            return ret;
+        }
+        ~imple()
+        {
+            for(cursor& c: cursors)
+                c.release();
+        }
+    };
+    //exporters served by export threads of same numa node, one group without numa config
+    struct group
+    {
+        lockfree_queue<imple*, 50> ies;
+        int32_t node;
+
+        group(int32_t node) : ies("exporters_queue"), node(node)
+        {
+        }
+    };
+    std::vector<std::unique_ptr<group> > groups;
 
-    void work_thread()
+    void work_thread(group* g)
     {
+        if(g->node >= 0)
+            numa_bind_thread(g->node);
+        lockfree_queue<imple*, 50>& ies = g->ies;
         try{
             imple* i = nullptr;
             while(can_run) {
@@ -282,6 +576,7 @@ class engine::impl : public stack_singleton<engine::impl>
 public:
     void loop_one()
     {
+        lockfree_queue<imple*, 50>& ies = groups[0]->ies;
         imple* i = nullptr;
         for(uint32_t c = 0; c != ies.capacity && can_run; ++c) {
             bool res = false;
@@ -297,27 +592,67 @@ public:
         if(i)
             ies.push(i);
     }
-    impl(volatile bool& can_run) : can_run(can_run), ies("exporters_queue")
+    impl(volatile bool& can_run) : can_run(can_run)
     {
     }
-    str_holder alloc()
+    str_holder alloc(context* ctx)
     {
-        linked_node* p = ll.alloc();
+        linked_node* p = shards[ctx->shard]->ll.alloc();
         return str_holder((const char*)p->m, sizeof(p->m));
     }
     void free(str_holder buf, context* ctx)
     {
         const char* m = (buf.str - ctx->buf_delta - sizeof(messages::_));
-        ll.free((linked_node*)m);
+        shards[ctx->shard]->ll.free((linked_node*)m);
     }
     void init()
     {
-        consumers = config::instance().exports.size();
-        for(const auto& e: config::instance().exports)
-            ies.push(new imple(ll, e));
+        const std::vector<uint32_t>& nodes = config::instance().shard_nodes;
+        if(nodes.empty()) {
+            groups.push_back(std::make_unique<group>(-1));
+            for(uint32_t i = 0; i != config::instance().shards; ++i)
+                shards.push_back(std::make_unique<shard>());
+        }
+        for(uint32_t i = 0; i != nodes.size(); ++i) {
+            shards.push_back(std::unique_ptr<shard>(create_shard(nodes[i])));
+            uint32_t g = 0;
+            while(g != groups.size() && groups[g]->node != int32_t(nodes[i]))
+                ++g;
+            if(g == groups.size())
+                groups.push_back(std::make_unique<group>(nodes[i]));
+            shards[i]->group = g;
+        }
+        uint32_t next_group = 0;
+
+        //export = shard number exporter params, for exporters of one shard
+        for(std::string e: config::instance().exports) {
+            uint32_t from = 0, to = shards.size();
+            if(e.size() > 6 && std::equal(e.begin(), e.begin() + 6, "shard ")) {
+                auto i = std::find(e.begin() + 6, e.end(), ' ');
+                from = lexical_cast<uint32_t>(std::string(e.begin() + 6, i));
+                if(from >= shards.size() || i == e.end())
+                    throw std::runtime_error(es() % "engine::init() bad shard export: " % e);
+                to = from + 1;
+                e = std::string(i + 1, e.end());
+            }
+            imple* p = new imple(e);
+            for(uint32_t i = from; i != to; ++i) {
+                p->cursors.push_back(cursor(shards[i]->ll));
+                ++shards[i]->consumers;
+            }
+            //exporter of one shard served near its importers, exporters of all shards spread by groups
+            uint32_t g = (to - from == 1) ? shards[from]->group : (next_group++) % groups.size();
+            groups[g]->ies.push(p);
+        }
+        for(uint32_t i = 0; i != shards.size(); ++i) {
+            if(!shards[i]->consumers)
+                throw std::runtime_error(es() % "engine::init() no exporters for shard " % i);
+        }
 
+        if(config::instance().export_threads < groups.size())
+            throw std::runtime_error(es() % "engine::init() export_threads less than numa nodes: " % groups.size());
         for(uint32_t i = 0; i != config::instance().export_threads; ++i)
-            threads.push_back(std::thread(&impl::work_thread, this));
+            threads.push_back(std::thread(&impl::work_thread, this, groups[i % groups.size()].get()));
     }
     void proceed(str_holder& buf, context* ctx)
     {
@@ -327,12 +662,23 @@ public:
         uint32_t count = full_size / message_size;
         uint32_t cur_delta = full_size % message_size;
 
+        linked_list& ll = shards[ctx->shard]->ll;
         const char* ptr = buf.str - ctx->buf_delta;
         message* m = (message*)(ptr);
         linked_node* n = (linked_node*)(ptr - sizeof(linked_node::_));
+        uint32_t exported = count;
+        if(unlikely(ctx->seq.active || (count && m->id == msg_seq)))
+            exported = ctx->seq.filter(m, count);
+        std::unique_lock<std::mutex> lock;
+        context* c = ctx;
+        if(ctx->arb) {
+            lock = std::unique_lock<std::mutex>(ctx->arb->mutex);
+            exported = ctx->arb->filter(*ctx, m, exported);
+            c = ctx->arb->ctx;
+        }
         set_export_mtime(m);
-        n->count = count;
-        n->cnt = consumers + 1;
+        n->count = exported;
+        n->cnt = shards[ctx->shard]->consumers + 1;
         ll.push(n);
         notify();
         
@@ -348,31 +694,34 @@ public:
         //if(!cur_delta)
         //    loop_one();
 
-        for(uint32_t i = 0; i != count; ++i, ++m)
+        for(uint32_t i = 0; i != exported; ++i, ++m)
         {
             switch(m->id.id) {
                 case(msg_book) : {
-                    ctx->check(m->mb.security_id, m->mb.time);
+                    c->check(m->mb.security_id, m->mb.time);
                     break;
                 }
                 case(msg_trade) : {
-                    ctx->check(m->mt.security_id, m->mt.time);
+                    c->check(m->mt.security_id, m->mt.time);
                     break;
                 }
                 case(msg_clean) : {
-                    ctx->check_clean(m->mc);
+                    c->check_clean(m->mc);
                     break;
                 }
                 case(msg_instr) : {
                     uint32_t security_id = calc_crc(m->mi);
                     if(security_id != m->mi.security_id)
                         throw std::runtime_error(es() % "instrument crc mismatch, in: " % m->mi.security_id % ", calculated: " % security_id);
-                    ctx->insert(security_id, m->mi.time);
+                    c->insert(security_id, m->mi.time);
                     break;
                 }
                 case(msg_ping) : {
                     break;
                 }
+                case(msg_bar) : {
+                    break;
+                }
                 case(msg_hello) : {
                     //mlog() << "<hello|" << t->name << "|" << t->time << "|";
                     break;
@@ -388,11 +737,14 @@ public:
         for(auto&& t: threads)
             t.join();
         imple *i = nullptr;
-        while(ies.pop_weak(i))
-            delete i;
+        for(auto& g: groups) {
+            while(g->ies.pop_weak(i))
+                delete i;
+        }
     }
-    void push_clean(const std::vector<actives::type>& secs) //when parser disconnected all OrdersBooks cleans
+    void push_clean(const std::vector<actives::type>& secs, uint32_t shard) //when parser disconnected all OrdersBooks cleans
     {
+        linked_list& ll = shards[shard]->ll;
         uint32_t count = secs.size();
         for(uint32_t ci = 0; ci != count;)
         {
@@ -400,7 +752,7 @@ public:
             linked_node* n = ll.alloc();
             set_export_mtime(n->m);
             n->count = cur_c;
-            n->cnt = consumers;
+            n->cnt = shards[shard]->consumers;
             for(uint32_t i = 0; i != cur_c; ++i, ++ci)
                 n->m[i].mc = message_clean{secs[ci].time, ttime_t(), msg_clean, "", secs[ci].security_id, 1/*source*/};
             ll.push(n);
@@ -420,10 +772,10 @@ engine::~engine()
 {
 }
 
-void actives::on_disconnect()
+void actives::on_disconnect(uint32_t shard)
 {
     mlog() << "actives::on_disconnect";
-    engine::impl::instance().push_clean(data);
+    engine::impl::instance().push_clean(data, shard);
     auto it = data.begin(), ie = data.end();
     for(; it != ie; ++it) {
         auto& v = get(it->security_id);
@@ -434,9 +786,63 @@ void actives::on_disconnect()
     }
 }
 
-void* context_create()
+void arbiter::disconnect(context& f)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    mlog() << "arbiter " << name << " feed " << f.feed << " disconnected, wins: " << f.wins << ", duplicates: " << f.duplicates
+        << ", avg lag us: " << (f.lags ? f.lag / f.lags / 1000 : 0) << ", leader switches: " << switches;
+    if(!--connected) {
+        delete ctx;
+        ctx = nullptr;
+        keys.clear();
+        return;
+    }
+    //books of securities without etime built only by this feed
+    std::vector<actives::type> secs;
+    for(auto& v: keys) {
+        emitted& em = v.second;
+        if(em.owner != f.feed)
+            continue;
+        em.owner = 0;
+        if(!em.etime.value && ctx->acs.active(v.first)) {
+            em.released = true;
+            actives::type& a = ctx->acs.get(v.first);
+            a.disconnected = true;
+            secs.push_back(a);
+        }
+    }
+    if(!secs.empty()) {
+        mlog() << "arbiter " << name << " securities without etime cleaned: " << secs.size();
+        engine::impl::instance().push_clean(secs, shard);
+    }
+}
+
+void* context_create(void* arb)
+{
+    return (void*)(new context((arbiter*)arb));
+}
+
+void* arbiter_create(const char* name)
 {
-    return (void*)(new context());
+    return (void*)(new arbiter(name));
+}
+
+void arbiter_destroy(void* arb)
+{
+    delete (arbiter*)arb;
+}
+
+void set_import_shard(uint32_t import)
+{
+    import_shard = import % config::instance().shards;
+    const std::vector<uint32_t>& nodes = config::instance().shard_nodes;
+    if(!nodes.empty())
+        numa_bind_thread(nodes[import_shard]);
+}
+
+uint32_t get_import_shard()
+{
+    return import_shard;
 }
 
 void context_destroy(void* ctx)
@@ -444,9 +850,9 @@ void context_destroy(void* ctx)
     delete (context*)ctx;
 }
 
-str_holder alloc_buffer()
+str_holder alloc_buffer(void* ctx)
 {
-    return engine::impl::instance().alloc();
+    return engine::impl::instance().alloc((context*)(ctx));
 }
 
 void free_buffer(str_holder buf, void* ctx)
@@ -460,3 +866,16 @@ void proceed_data(str_holder& buf, void* ctx)
     return engine::impl::instance().proceed(buf, (context*)(ctx));
 }
 
+bool replay_request(void* ctx, message& m)
+{
+    sequence& s = ((context*)(ctx))->seq;
+    if(likely(!s.request))
+        return false;
+    s.request = false;
+    m.ms = message_seq();
+    m.ms.time = get_cur_ttime();
+    m.ms.id = msg_seq;
+    m.ms.seq = s.expected;
+    return true;
+}
+
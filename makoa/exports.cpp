@@ -6,19 +6,34 @@
 #include "exports.hpp"
 #include "types.hpp"
 #include "mmap.hpp"
+#include "retransmit.hpp"
+#include "query.hpp"
+#include "tob.hpp"
 
 #include "tyra/tyra.hpp"
 
 #include "evie/utils.hpp"
 #include "evie/mlog.hpp"
 #include "evie/profiler.hpp"
+#include "evie/socket.hpp"
 
 #include <dlfcn.h>
 #include <fcntl.h>
 #include <unistd.h>
 #include <sys/stat.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <sys/vfs.h>
+
+#include <linux/magic.h>
 
 #include <atomic>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <unordered_map>
+#include <deque>
+#include <cstring>
 
 inline void init_smc(void* ptr)
 {
@@ -47,16 +62,30 @@ void* mmap_create(const char* params, bool create)
     if(h <= 0)
         throw_system_failure(es() % "open " % _str_holder(params) % " error");
 
-    bool r = lseek(h, mmap_alloc_size, SEEK_SET) >= 0;
-    r &= (write(h, "", 1) == 1);
-    r &= (lseek(h, 0, SEEK_SET) >= 0);
+    //hugetlbfs files can't be written, only truncated to whole hugepages
+    struct statfs fs;
+    bool huge = !fstatfs(h, &fs) && fs.f_type == HUGETLBFS_MAGIC;
+    if(huge && fs.f_bsize > mmap_map_size) {
+        ::close(h);
+        throw std::runtime_error(es() % "mmap_create() " % _str_holder(params) % " hugepage size " % fs.f_bsize % " not supported");
+    }
+    bool r = true;
+    if(huge)
+        r = !ftruncate(h, mmap_map_size);
+    else {
+        r &= lseek(h, mmap_map_size - 1, SEEK_SET) >= 0;
+        r &= (write(h, "", 1) == 1);
+        r &= (lseek(h, 0, SEEK_SET) >= 0);
+    }
     if(!r)
         throw_system_failure(es() % "mmap creating file error " % _str_holder(params));
 
-    void* p = mmap(NULL, mmap_alloc_size, PROT_READ | PROT_WRITE, MAP_SHARED, h, 0);
+    void* p = mmap(NULL, mmap_map_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, h, 0);
     ::close(h);
-    if(!p)
+    if(p == MAP_FAILED)
         throw_system_failure(es() % "mmap error for " % _str_holder(params));
+    if(!huge)
+        madvise(p, mmap_map_size, MADV_HUGEPAGE);
 
     if(create)
         init_smc(p);
@@ -80,6 +109,8 @@ namespace
                 mlog() << "<" << m->mp;
             else if(m->id == msg_hello)
                 mlog() << "<" << m->dratuti;
+            else if(m->id == msg_bar)
+                mlog() << "<" << m->mbar;
         }
         mlog() << "<flush|";
     }
@@ -200,27 +231,61 @@ namespace
         ret.p = ret.he.init(params.c_str());
         return ret;
     }
-    void* pipe_init(const char* params)
+    //pipe and mmap_cp batches are prefixed by message_seq envelope, so importer detects lost data
+    message_seq seq_envelope(uint64_t& seq, uint32_t count)
     {
-        int r = mkfifo(params, 0666);
-        my_unused(r);
-        int64_t h = ::open(params, O_WRONLY);
-        if(h <= 0)
-            throw_system_failure(es() % "open " % _str_holder(params) % " error");
+        message_seq s = message_seq();
+        s.time = get_cur_ttime();
+        s.id = msg_seq;
+        s.seq = seq;
+        s.count = count;
+        seq += count;
+        return s;
+    }
+    struct pipe_export : noncopyable
+    {
+        int h;
+        uint64_t seq;
 
-        return (void*)h;
+        pipe_export(const char* params) : seq()
+        {
+            int r = mkfifo(params, 0666);
+            my_unused(r);
+            h = ::open(params, O_WRONLY);
+            if(h <= 0)
+                throw_system_failure(es() % "open " % _str_holder(params) % " error");
+        }
+        ~pipe_export()
+        {
+            ::close(h);
+        }
+        void proceed(const message* m, uint32_t count)
+        {
+            message_seq s = seq_envelope(seq, count);
+            iovec iov[2] = {{(void*)&s, message_size}, {(void*)m, count * message_size}};
+            ssize_t wsize = (count + 1) * message_size;
+            ssize_t ret = ::writev(h, iov, 2);
+            if(unlikely(ret != wsize))
+                throw_system_failure(es() % "pipe::write, wsize: " % wsize  % ", ret: " % ret);
+        }
+    };
+    void* pipe_init(const char* params)
+    {
+        return new pipe_export(params);
     }
     void pipe_destroy(void* p)
     {
-        ::close(int((int64_t)p));
+        delete (pipe_export*)p;
     }
     void pipe_proceed(void* p, const message* m, uint32_t count)
     {
-        uint32_t wsize = sizeof(message) * count;
-        ssize_t ret = ::write(int((int64_t)p), (const void*)m, wsize);
-        if(unlikely(ret != wsize))
-            throw_system_failure(es() % "pipe::write, wsize: " % wsize  % ", ret: " % ret);
+        ((pipe_export*)p)->proceed(m, count);
     }
+    struct mmap_cp
+    {
+        void* p;
+        uint64_t seq;
+    };
     void* mmap_init(const char* params)
     {
         void *p = mmap_create(params, false);
@@ -233,15 +298,18 @@ namespace
         *(++c) = 1;
         pthread_cond_signal(&(s->condition));
 		pthread_mutex_unlock(&(s->mutex));
-        return p;
+        return new mmap_cp({p, 0});
     }
-    void mmap_destroy(void *p)
+    void mmap_destroy(void *v)
     {
-        if(munmap(p, mmap_alloc_size) < 0)
+        std::unique_ptr<mmap_cp> mc((mmap_cp*)v);
+        if(munmap(mc->p, mmap_map_size) < 0)
             throw_system_failure(es() % "munmmap error");
     }
-    void mmap_proceed(void* v, const message* m, uint32_t count)
+    void mmap_proceed(void* ptr, const message* m, uint32_t count)
     {
+        mmap_cp* mc = (mmap_cp*)ptr;
+        void* v = mc->p;
         bool flub = false;
         std::atomic_uchar* f = ((std::atomic_uchar*)v), *e = f + message_size, *i = f;
 
@@ -256,9 +324,10 @@ namespace
         uint32_t c = 0;
         while(c != count)
         {
+            //block of 255 messages holds envelope and 254 messages
             uint32_t cur_count = (count - c);
-            if(cur_count > 255)
-                cur_count = 255;
+            if(cur_count > 254)
+                cur_count = 254;
 
             uint8_t nf = atomic_load(i);
             if(nf) {
@@ -272,8 +341,10 @@ namespace
                 if(nf)
                     throw std::runtime_error(es() % "mmap_proceed() map overload, wp: " % uint32_t(*f) % ", rp: " % uint32_t(*(f + 1)));
             }
-            memcpy(p, m + c, cur_count * message_size);
-            atomic_store(i, uint8_t(cur_count));
+            message_seq se = seq_envelope(mc->seq, cur_count);
+            memcpy(p, &se, message_size);
+            memcpy(p + 1, m + c, cur_count * message_size);
+            atomic_store(i, uint8_t(cur_count + 1));
             //mlog() << "mmap_proceed(" << uint64_t(v) << "," << uint64_t(p) << "," << c << "," << cur_count
             //    << "," << uint32_t(atomic_load(f)) << "," << uint32_t(atomic_load(f + 1)) << ")";
             p += 255;
@@ -297,6 +368,1156 @@ namespace
             pthread_mutex_unlock(&(ps->mutex));
         }
     }
+
+    //udp multicast of sequenced datagrams, lost ones replayed by requests over tcp side channel,
+    //params: group:port tcp_port [window]
+    struct mcast : noncopyable
+    {
+        //messages in datagram after envelope, fits ethernet mtu
+        static constexpr uint32_t max_count = 28;
+
+        int socket;
+        sockaddr_in group;
+        uint16_t port;
+        std::unique_ptr<retransmit_window> history;
+
+        volatile bool can_run;
+        std::mutex mutex;
+        std::condition_variable cond;
+        uint32_t clients;
+        uint64_t replays;
+        std::thread server;
+
+        mcast(const std::string& params) : socket(-1), group(), can_run(true), clients(), replays()
+        {
+            std::vector<std::string> p = split(params, ' ');
+            if(p.size() != 2 && p.size() != 3)
+                throw std::runtime_error(es() % "mcast() bad params: " % params);
+            std::vector<std::string> g = split(p[0], ':');
+            if(g.size() != 2)
+                throw std::runtime_error(es() % "mcast() bad group: " % p[0]);
+            port = lexical_cast<uint16_t>(p[1]);
+            history.reset(new retransmit_window(p.size() == 3 ? lexical_cast<uint32_t>(p[2]) : 64 * 1024));
+
+            group.sin_family = AF_INET;
+            group.sin_port = htons(lexical_cast<uint16_t>(g[1]));
+            if(inet_pton(AF_INET, g[0].c_str(), &group.sin_addr) != 1)
+                throw std::runtime_error(es() % "mcast() bad group address: " % g[0]);
+            socket = ::socket(AF_INET, SOCK_DGRAM, 0);
+            if(socket < 0)
+                throw_system_failure("mcast() open socket error");
+            uint8_t loop = 1;
+            if(setsockopt(socket, IPPROTO_IP, IP_MULTICAST_LOOP, &loop, sizeof(loop)) < 0)
+                throw_system_failure("mcast() set IP_MULTICAST_LOOP error");
+            server = std::thread(&mcast::serve, this);
+            mlog() << "mcast() " << params;
+        }
+        void proceed(const message* m, uint32_t count)
+        {
+            ttime_t time = get_cur_ttime();
+            for(uint32_t c = 0; c != count;) {
+                uint32_t cnt = std::min(count - c, max_count);
+                iovec iov[2];
+                uint32_t parts = 0;
+                std::unique_lock<std::mutex> lock(mutex);
+                uint64_t from = history->position();
+                history->push(m + c, cnt, time);
+                history->read(from, history->position(), [&](const message* p, uint32_t n) {
+                    iov[parts].iov_base = (void*)p;
+                    iov[parts++].iov_len = n * message_size;
+                });
+                msghdr mh = msghdr();
+                mh.msg_name = &group;
+                mh.msg_namelen = sizeof(group);
+                mh.msg_iov = iov;
+                mh.msg_iovlen = parts;
+                if(unlikely(sendmsg(socket, &mh, 0) < 0))
+                    throw_system_failure("mcast sendmsg() error");
+                c += cnt;
+            }
+        }
+        void serve()
+        {
+            while(can_run) {
+                try {
+                    std::string client;
+                    int s = my_accept_async(port, false, true, &client, &can_run, "mcast");
+                    std::unique_lock<std::mutex> lock(mutex);
+                    ++clients;
+                    std::thread(&mcast::serve_client, this, s, client).detach();
+                }
+                catch(std::exception& e) {
+                    if(can_run) {
+                        mlog(mlog::error) << "mcast::serve() " << e;
+                        sleep(1);
+                    }
+                }
+            }
+        }
+        void serve_client(int s, std::string client)
+        {
+            try {
+                socket_holder sh(s);
+                message r;
+                uint32_t rs = 0;
+                std::vector<message> buf;
+                pollfd pfd = pollfd();
+                pfd.events = POLLIN;
+                pfd.fd = s;
+                while(can_run) {
+                    int ret = poll(&pfd, 1, 100);
+                    if(ret < 0)
+                        throw_system_failure("poll() error");
+                    if(!ret)
+                        continue;
+                    ret = ::recv(s, (char*)&r + rs, message_size - rs, 0);
+                    if(ret <= 0)
+                        throw_system_failure("socket closed");
+                    rs += ret;
+                    if(rs != message_size)
+                        continue;
+                    rs = 0;
+                    if(unlikely(r.id.id != msg_seq))
+                        throw std::runtime_error(es() % "mcast request bad msg_id: " % r.id.id);
+                    buf.clear();
+                    {
+                        std::unique_lock<std::mutex> lock(mutex);
+                        uint64_t pos;
+                        if(history->find(r.ms.seq, pos))
+                            history->read(pos, history->find_end(r.ms.seq + r.ms.count), [&buf](const message* m, uint32_t n) {
+                                buf.insert(buf.end(), m, m + n);
+                            });
+                        else {
+                            mlog(mlog::critical) << "mcast " << client << " request from " << r.ms.seq << " out of window, seq: " << history->get_seq();
+                            message_seq reset = history->reset(get_cur_ttime());
+                            buf.push_back(reinterpret_cast<const message&>(reset));
+                        }
+                        ++replays;
+                    }
+                    socket_send(s, (const char*)buf.data(), buf.size() * message_size);
+                }
+            }
+            catch(std::exception& e) {
+                mlog(mlog::error) << "mcast client " << client << " " << e;
+            }
+            std::unique_lock<std::mutex> lock(mutex);
+            --clients;
+            cond.notify_all();
+        }
+        ~mcast()
+        {
+            can_run = false;
+            server.join();
+            std::unique_lock<std::mutex> lock(mutex);
+            while(clients)
+                cond.wait_for(lock, std::chrono::microseconds(50 * 1000));
+            mlog() << "~mcast() seq: " << history->get_seq() << ", replays: " << replays;
+            if(socket >= 0)
+                ::close(socket);
+        }
+    };
+    void* mcast_init(const char* params)
+    {
+        return new mcast(params);
+    }
+    void mcast_destroy(void* p)
+    {
+        delete (mcast*)p;
+    }
+    void mcast_proceed(void* p, const message* m, uint32_t count)
+    {
+        ((mcast*)p)->proceed(m, count);
+    }
+
+    //keeps instruments and books of exported stream, params: exporter params,
+    //on inner exporter error recreates it every second and starts new subscription
+    //from snapshot (instr, clean, levels) of current state, then live stream without gap
+    struct snapshot : noncopyable
+    {
+        struct security
+        {
+            message_instr instr;
+            //last message time, makoa requires not decreasing times of security
+            ttime_t time;
+            std::map<int64_t, message_book> levels;
+        };
+
+        std::string params;
+        exporter exp;
+        std::map<uint32_t, security> securities;
+        std::vector<message> buf;
+        time_t reconnect_time;
+        uint64_t subscriptions;
+
+        snapshot(const std::string& params) : params(params), reconnect_time(), subscriptions()
+        {
+            subscribe();
+        }
+        void apply(const message& m)
+        {
+            if(m.id == msg_book) {
+                const message_book& mb = m.mb;
+                security& s = securities[mb.security_id];
+                s.time = mb.time;
+                if(!mb.count.value) {
+                    s.levels.erase(mb.level_id);
+                    return;
+                }
+                message_book& l = s.levels[mb.level_id];
+                if(mb.price.value || !l.price.value)
+                    l = mb;
+                else {
+                    price_t price = l.price;
+                    l = mb;
+                    l.price = price;
+                }
+            }
+            else if(m.id == msg_trade)
+                securities[m.mt.security_id].time = m.mt.time;
+            else if(m.id == msg_instr) {
+                security& s = securities[m.mi.security_id];
+                s.instr = m.mi;
+                s.time = m.mi.time;
+                s.levels.clear();
+            }
+            else if(m.id == msg_clean) {
+                security& s = securities[m.mc.security_id];
+                s.time = m.mc.time;
+                s.levels.clear();
+            }
+        }
+        void send_snapshot()
+        {
+            buf.resize(1);
+            for(auto& v: securities) {
+                security& s = v.second;
+                if(s.instr.id == msg_instr) {
+                    buf.push_back(reinterpret_cast<const message&>(s.instr));
+                    buf.back().t.time = s.time;
+                }
+                message_clean mc = message_clean();
+                mc.time = s.time;
+                mc.id = msg_clean;
+                mc.security_id = v.first;
+                buf.push_back(reinterpret_cast<const message&>(mc));
+                for(auto& l: s.levels) {
+                    buf.push_back(reinterpret_cast<const message&>(l.second));
+                    buf.back().t.time = s.time;
+                }
+            }
+            mlog() << "snapshot(" << params << ") subscription " << subscriptions << ", securities: "
+                << securities.size() << ", messages: " << (buf.size() - 1);
+            if(buf.size() > 1) {
+                set_export_mtime(&buf[1]);
+                exp.proceed(&buf[1], buf.size() - 1);
+            }
+        }
+        void subscribe()
+        {
+            try {
+                exp = exporter(params);
+                ++subscriptions;
+                send_snapshot();
+            }
+            catch(std::exception& e) {
+                mlog(mlog::error) << "snapshot(" << params << ") " << e;
+                unsubscribe();
+            }
+        }
+        void unsubscribe()
+        {
+            exporter e(std::move(exp));
+            reconnect_time = time(NULL) + 1;
+        }
+        void proceed(const message* m, uint32_t count)
+        {
+            for(uint32_t i = 0; i != count; ++i)
+                apply(m[i]);
+            if(unlikely(!exp.he.proceed)) {
+                if(time(NULL) >= reconnect_time)
+                    subscribe();
+                return;
+            }
+            try {
+                exp.proceed(m, count);
+            }
+            catch(std::exception& e) {
+                mlog(mlog::error) << "snapshot(" << params << ") " << e;
+                unsubscribe();
+            }
+        }
+    };
+    void* snapshot_init(const char* params)
+    {
+        return new snapshot(params);
+    }
+    void snapshot_destroy(void* p)
+    {
+        delete (snapshot*)p;
+    }
+    void snapshot_proceed(void* p, const message* m, uint32_t count)
+    {
+        ((snapshot*)p)->proceed(m, count);
+    }
+
+    //price books of securities published to tob slots after every batch,
+    //slots and its count owned by user, f(security_id, slot) called for new slots
+    struct tob_books : noncopyable
+    {
+        struct book : price_book
+        {
+            ttime_t time;
+            tob_shared_slot* s;
+            bool dirty;
+        };
+
+        std::string name;
+        tob_shared_slot* slots;
+        std::atomic<uint32_t>& count;
+        uint32_t max_securities;
+
+        std::map<uint32_t, book> books;
+        std::vector<book*> dirty;
+
+        tob_books(const std::string& name, tob_shared_slot* slots, std::atomic<uint32_t>& count, uint32_t max_securities)
+            : name(name), slots(slots), count(count), max_securities(max_securities)
+        {
+        }
+        template<typename func>
+        book& get(uint32_t security_id, func f)
+        {
+            auto it = books.find(security_id);
+            if(likely(it != books.end()))
+                return it->second;
+            book& b = books[security_id];
+            uint32_t c = count.load(std::memory_order_relaxed);
+            if(c == max_securities) {
+                mlog(mlog::critical) << name << " max_securities " << max_securities << " exceed, security_id: " << security_id;
+                return b;
+            }
+            b.s = &slots[c];
+            b.s->security_id = security_id;
+            f(security_id, c);
+            count.store(c + 1, std::memory_order_release);
+            return b;
+        }
+        void set_dirty(book& b, ttime_t time)
+        {
+            b.time = time;
+            if(!b.dirty) {
+                b.dirty = true;
+                dirty.push_back(&b);
+            }
+        }
+        template<typename func>
+        void proceed(const message* m, uint32_t cnt, func f)
+        {
+            for(uint32_t i = 0; i != cnt; ++i, ++m) {
+                if(m->id == msg_book) {
+                    const message_book& mb = m->mb;
+                    book& b = get(mb.security_id, f);
+                    b.set(mb);
+                    set_dirty(b, mb.time);
+                }
+                else if(m->id == msg_trade) {
+                    book& b = get(m->mt.security_id, f);
+                    if(b.s)
+                        b.s->write([&]() {b.s->trade = m->mt;});
+                }
+                else if(m->id == msg_instr) {
+                    book& b = get(m->mi.security_id, f);
+                    b.clear();
+                    if(b.s)
+                        b.s->write([&]() {std::copy(m->mi.exchange_id, m->mi.exchange_id + sizeof(b.s->exchange_id), b.s->exchange_id);});
+                    set_dirty(b, m->mi.time);
+                }
+                else if(m->id == msg_clean) {
+                    book& b = get(m->mc.security_id, f);
+                    b.clear();
+                    set_dirty(b, m->mc.time);
+                }
+            }
+            for(book* b: dirty) {
+                b->dirty = false;
+                if(b->s)
+                    b->s->publish(*b, b->time);
+            }
+            dirty.clear();
+        }
+    };
+
+    //books of all securities for query clients on unix socket, protocol in query.hpp,
+    //params: path [max_securities], exporter thread publishes top levels to seqlocked slots,
+    //so queries never block it
+    struct query : noncopyable
+    {
+        static_assert(query_max_depth == tob_depth && sizeof(query_level) == sizeof(tob_level));
+
+        std::string path;
+        uint32_t max_securities, mask;
+        std::unique_ptr<tob_shared_slot[]> slots;
+        //security_id << 32 | (slot + 1), open addressing, filled by exporter thread only
+        std::unique_ptr<std::atomic<uint64_t>[]> index;
+        std::atomic<uint32_t> count;
+        std::unique_ptr<tob_books> books;
+
+        int socket;
+        volatile bool can_run;
+        std::mutex mutex;
+        std::condition_variable cond;
+        uint32_t clients;
+        std::atomic<uint64_t> queries;
+        std::thread server;
+
+        query(const std::string& params) : max_securities(16 * 1024), count(), socket(-1), can_run(true), clients(), queries()
+        {
+            std::vector<std::string> p = split(params, ' ');
+            if(p.empty() || p.size() > 2)
+                throw std::runtime_error(es() % "query() bad params: " % params);
+            path = p[0];
+            if(p.size() == 2)
+                max_securities = lexical_cast<uint32_t>(p[1]);
+            uint32_t size = 2;
+            while(size < 2 * max_securities)
+                size *= 2;
+            mask = size - 1;
+            slots.reset(new tob_shared_slot[max_securities]());
+            index.reset(new std::atomic<uint64_t>[size]());
+            books = std::make_unique<tob_books>("query()", slots.get(), count, max_securities);
+
+            sockaddr_un addr = sockaddr_un();
+            addr.sun_family = AF_UNIX;
+            if(path.size() >= sizeof(addr.sun_path))
+                throw std::runtime_error(es() % "query() too long path: " % path);
+            std::copy(path.begin(), path.end(), addr.sun_path);
+            ::unlink(path.c_str());
+            socket = ::socket(AF_UNIX, SOCK_STREAM, 0);
+            if(socket < 0)
+                throw_system_failure("query() open socket error");
+            if(bind(socket, (sockaddr*)&addr, sizeof(addr)) < 0)
+                throw_system_failure(es() % "query() bind() error: " % path);
+            if(listen(socket, 16) < 0)
+                throw_system_failure("query() listen() error");
+            server = std::thread(&query::serve, this);
+            mlog() << "query() " << params;
+        }
+        static uint32_t hash(uint32_t security_id)
+        {
+            return (uint64_t(security_id) * 0x9E3779B97F4A7C15ull) >> 32;
+        }
+        const tob_shared_slot* find(uint32_t security_id) const
+        {
+            for(uint32_t i = hash(security_id) & mask;; i = (i + 1) & mask) {
+                uint64_t v = index[i].load(std::memory_order_acquire);
+                if(!v)
+                    return nullptr;
+                if(uint32_t(v >> 32) == security_id)
+                    return &slots[uint32_t(v) - 1];
+            }
+        }
+        void proceed(const message* m, uint32_t cnt)
+        {
+            books->proceed(m, cnt, [this](uint32_t security_id, uint32_t c) {
+                uint32_t i = hash(security_id) & mask;
+                while(index[i].load(std::memory_order_relaxed))
+                    i = (i + 1) & mask;
+                index[i].store((uint64_t(security_id) << 32) | (c + 1), std::memory_order_release);
+            });
+        }
+        static query_book make_book(const tob_shared_slot& s)
+        {
+            query_book qb = query_book();
+            qb.time = s.time;
+            qb.security_id = s.security_id;
+            qb.bids = s.bids;
+            qb.asks = s.asks;
+            std::copy(s.exchange_id, s.exchange_id + sizeof(s.exchange_id), qb.exchange_id);
+            return qb;
+        }
+        void answer(const query_request& r, std::vector<char>& buf) const
+        {
+            buf.resize(sizeof(query_reply));
+            query_reply qr = query_reply{r.type, 0};
+            if(r.type == query_depth) {
+                const tob_shared_slot* s = find(r.security_id);
+                if(s) {
+                    query_book qb;
+                    tob_level levels[2 * query_max_depth];
+                    s->read([&]() {
+                        qb = make_book(*s);
+                        std::copy(s->levels, s->levels + 2 * query_max_depth, levels);
+                    });
+                    uint32_t depth = std::min(r.depth, query_max_depth);
+                    qb.bids = std::min(qb.bids, depth);
+                    qb.asks = std::min(qb.asks, depth);
+                    buf.insert(buf.end(), (const char*)&qb, (const char*)(&qb + 1));
+                    buf.insert(buf.end(), (const char*)levels, (const char*)(levels + qb.bids));
+                    buf.insert(buf.end(), (const char*)(levels + query_max_depth), (const char*)(levels + query_max_depth + qb.asks));
+                    qr.count = 1;
+                }
+            }
+            else if(r.type == query_bbo) {
+                bool all = !r.exchange_id[0];
+                for(uint32_t i = 0, c = count.load(std::memory_order_acquire); i != c; ++i) {
+                    const tob_shared_slot& s = slots[i];
+                    query_book qb;
+                    tob_level bid, ask;
+                    s.read([&]() {
+                        qb = make_book(s);
+                        bid = s.levels[0];
+                        ask = s.levels[query_max_depth];
+                    });
+                    if(!all && !std::equal(r.exchange_id, r.exchange_id + sizeof(r.exchange_id), qb.exchange_id))
+                        continue;
+                    query_quote b = query_quote();
+                    b.time = qb.time;
+                    b.security_id = qb.security_id;
+                    if(qb.bids)
+                        b.bid = query_level{bid.price, bid.count};
+                    if(qb.asks)
+                        b.ask = query_level{ask.price, ask.count};
+                    buf.insert(buf.end(), (const char*)&b, (const char*)(&b + 1));
+                    ++qr.count;
+                }
+            }
+            else
+                throw std::runtime_error(es() % "query bad request type: " % r.type);
+            std::copy((const char*)&qr, (const char*)(&qr + 1), &buf[0]);
+        }
+        void serve()
+        {
+            pollfd pfd = pollfd();
+            pfd.events = POLLIN;
+            pfd.fd = socket;
+            while(can_run) {
+                try {
+                    int ret = poll(&pfd, 1, 100);
+                    if(ret < 0)
+                        throw_system_failure("poll() error");
+                    if(!ret)
+                        continue;
+                    int s = accept(socket, nullptr, nullptr);
+                    if(s < 0)
+                        throw_system_failure("accept() error");
+                    std::unique_lock<std::mutex> lock(mutex);
+                    ++clients;
+                    std::thread(&query::serve_client, this, s).detach();
+                }
+                catch(std::exception& e) {
+                    mlog(mlog::error) << "query::serve() " << e;
+                    sleep(1);
+                }
+            }
+        }
+        void serve_client(int s)
+        {
+            try {
+                socket_holder sh(s);
+                query_request r;
+                uint32_t rs = 0;
+                std::vector<char> buf;
+                pollfd pfd = pollfd();
+                pfd.events = POLLIN;
+                pfd.fd = s;
+                while(can_run) {
+                    int ret = poll(&pfd, 1, 100);
+                    if(ret < 0)
+                        throw_system_failure("poll() error");
+                    if(!ret)
+                        continue;
+                    ret = ::recv(s, (char*)&r + rs, sizeof(r) - rs, 0);
+                    if(!ret)
+                        break;
+                    if(ret < 0)
+                        throw_system_failure("recv() error");
+                    rs += ret;
+                    if(rs != sizeof(r))
+                        continue;
+                    rs = 0;
+                    answer(r, buf);
+                    ++queries;
+                    socket_send(s, &buf[0], buf.size());
+                }
+            }
+            catch(std::exception& e) {
+                mlog(mlog::error) << "query client " << e;
+            }
+            std::unique_lock<std::mutex> lock(mutex);
+            --clients;
+            cond.notify_all();
+        }
+        ~query()
+        {
+            can_run = false;
+            server.join();
+            std::unique_lock<std::mutex> lock(mutex);
+            while(clients)
+                cond.wait_for(lock, std::chrono::microseconds(50 * 1000));
+            mlog() << "~query() securities: " << count.load() << ", queries: " << queries.load();
+            ::close(socket);
+            ::unlink(path.c_str());
+        }
+    };
+    void* query_init(const char* params)
+    {
+        return new query(params);
+    }
+    void query_destroy(void* p)
+    {
+        delete (query*)p;
+    }
+    void query_proceed(void* p, const message* m, uint32_t count)
+    {
+        ((query*)p)->proceed(m, count);
+    }
+
+    //top levels and last trade of all securities in shared memory for other processes,
+    //params: path [max_securities], layout and reader in tob.hpp
+    struct tob_export : noncopyable
+    {
+        tob_map map;
+        tob_books books;
+
+        tob_export(const std::vector<std::string>& p) : map(p.at(0), true, p.size() == 2 ? lexical_cast<uint32_t>(p[1]) : 16 * 1024),
+            books("tob()", map.slots, map.header->count, map.header->max_securities)
+        {
+            if(p.size() > 2)
+                throw std::runtime_error(es() % "tob() bad params count: " % p.size());
+            mlog() << "tob() " << p[0] << ", max_securities: " << map.header->max_securities;
+        }
+        ~tob_export()
+        {
+            mlog() << "~tob() securities: " << map.header->count.load();
+        }
+        void proceed(const message* m, uint32_t count)
+        {
+            books.proceed(m, count, [](uint32_t, uint32_t) {});
+        }
+    };
+    void* tob_init(const char* params)
+    {
+        return new tob_export(split(params, ' '));
+    }
+    void tob_destroy(void* p)
+    {
+        delete (tob_export*)p;
+    }
+    void tob_proceed(void* p, const message* m, uint32_t count)
+    {
+        ((tob_export*)p)->proceed(m, count);
+    }
+
+    //reduces stream to best bid and ask for exporter from params,
+    //books replaced by levels 1 (bid) and 2 (ask) sent only when best price or count changes,
+    //other messages forwarded as is
+    struct bbo : noncopyable
+    {
+        struct security : price_book
+        {
+            int64_t bid_price, bid_count, ask_price, ask_count;
+        };
+
+        exporter exp;
+        std::map<uint32_t, security> securities;
+        std::vector<message> buf;
+        uint64_t books, sent;
+
+        bbo(const std::string& params) : exp(params), buf(1), books(), sent()
+        {
+            mlog() << "bbo() " << params;
+        }
+        ~bbo()
+        {
+            mlog() << "~bbo() books: " << books << ", sent: " << sent;
+        }
+        void push(const message_book& mb, int64_t level_id, int64_t price, int64_t count)
+        {
+            buf.push_back(reinterpret_cast<const message&>(mb));
+            message_book& b = buf.back().mb;
+            b.level_id = level_id;
+            b.price.value = price;
+            b.count.value = count;
+            ++sent;
+        }
+        //empty side sent as zero count at previous price
+        void check(const message_book& mb, security& s)
+        {
+            int64_t price = 0, count = 0;
+            if(!s.bids.empty()) {
+                price = s.bids.begin()->first;
+                count = s.bids.begin()->second;
+            }
+            if(price != s.bid_price || count != s.bid_count) {
+                push(mb, 1, price ? price : s.bid_price, count);
+                s.bid_price = price;
+                s.bid_count = count;
+            }
+            price = 0, count = 0;
+            if(!s.asks.empty()) {
+                price = s.asks.begin()->first;
+                count = s.asks.begin()->second;
+            }
+            if(price != s.ask_price || count != s.ask_count) {
+                push(mb, 2, price ? price : s.ask_price, count);
+                s.ask_price = price;
+                s.ask_count = count;
+            }
+        }
+        void proceed(const message* m, uint32_t count)
+        {
+            buf.resize(1);
+            buf[0].t.time = get_export_mtime(m);
+            for(uint32_t i = 0; i != count; ++i, ++m) {
+                if(m->id == msg_book) {
+                    ++books;
+                    security& s = securities[m->mb.security_id];
+                    s.set(m->mb);
+                    check(m->mb, s);
+                    continue;
+                }
+                if(m->id == msg_instr || m->id == msg_clean) {
+                    security& s = securities[m->id == msg_instr ? m->mi.security_id : m->mc.security_id];
+                    s.clear();
+                    s.bid_price = s.bid_count = s.ask_price = s.ask_count = 0;
+                }
+                buf.push_back(*m);
+            }
+            if(buf.size() > 1)
+                exp.proceed(&buf[1], buf.size() - 1);
+        }
+    };
+    void* bbo_init(const char* params)
+    {
+        return new bbo(params);
+    }
+    void bbo_destroy(void* p)
+    {
+        delete (bbo*)p;
+    }
+    void bbo_proceed(void* p, const message* m, uint32_t count)
+    {
+        ((bbo*)p)->proceed(m, count);
+    }
+    //period like 100ms, 1s, 5m, 1h, 1d or number of seconds
+    uint64_t parse_period(const std::string& p)
+    {
+        uint64_t mult = ttime_t::frac;
+        uint32_t sz = p.size();
+        if(sz > 2 && p[sz - 2] == 'm' && p[sz - 1] == 's')
+            mult /= 1000, sz -= 2;
+        else if(sz > 1 && p[sz - 1] == 's')
+            sz -= 1;
+        else if(sz > 1 && p[sz - 1] == 'm')
+            mult *= 60, sz -= 1;
+        else if(sz > 1 && p[sz - 1] == 'h')
+            mult *= 3600, sz -= 1;
+        else if(sz > 1 && p[sz - 1] == 'd')
+            mult *= 24 * 3600, sz -= 1;
+        uint64_t v = lexical_cast<uint64_t>(p.substr(0, sz));
+        if(!v)
+            throw std::runtime_error(es() % "bars zero period: " % p);
+        return v * mult;
+    }
+
+    //aggregates trades to bars by parser time, params: periods exporter params,
+    //periods separated by comma (1s,1m), bar closed when export time passed its end by close_delay,
+    //exports message_bar for closed bars and instr messages, other messages skipped
+    struct bars : noncopyable
+    {
+        static constexpr uint32_t max_periods = 8;
+        static const uint64_t close_delay = ttime_t::frac / 10;
+
+        struct bar
+        {
+            uint64_t bucket, next; //next is first bucket not sent yet
+            int64_t open, high, low, close, volume, buy, sell, trades;
+            __int128 turnover;
+            bool opened;
+        };
+        struct security
+        {
+            bar b[max_periods];
+        };
+        typedef std::pair<uint32_t, bar*> opened_bar;
+
+        uint64_t periods[max_periods];
+        uint64_t closed[max_periods]; //buckets before it already closed
+        std::vector<opened_bar> opened[max_periods];
+        uint32_t count;
+
+        exporter exp;
+        std::unordered_map<uint32_t, security> securities;
+        std::vector<message> buf;
+        uint64_t trades, late, sent;
+
+        bars(const std::string& params) : periods(), closed(), count(), buf(1), trades(), late(), sent()
+        {
+            mlog() << "bars() " << params;
+            auto i = std::find(params.begin(), params.end(), ' ');
+            if(i == params.end())
+                throw std::runtime_error(es() % "bars() bad params: " % params);
+            std::vector<std::string> p = split(std::string(params.begin(), i), ',');
+            if(p.size() > max_periods)
+                throw std::runtime_error(es() % "bars() max periods " % max_periods % ", params: " % params);
+            for(const std::string& v: p) {
+                periods[count] = parse_period(v);
+                opened[count].reserve(64 * 1024);
+                ++count;
+            }
+            securities.reserve(64 * 1024);
+            buf.reserve(16 * 1024);
+            exp = exporter(std::string(i + 1, params.end()));
+        }
+        ~bars()
+        {
+            mlog() << "~bars() trades: " << trades << ", late: " << late << ", sent: " << sent;
+        }
+        void send(uint32_t security_id, uint64_t period, bar& b)
+        {
+            message m = message();
+            message_bar& r = m.mbar;
+            r.time.value = (b.bucket + 1) * period;
+            r.etime.value = b.bucket * period;
+            r.id = msg_bar;
+            r.security_id = security_id;
+
+            r.part = bar_prices;
+            r.open.value = b.open;
+            r.high.value = b.high;
+            r.low.value = b.low;
+            buf.push_back(m);
+
+            r.part = bar_volumes;
+            r.close.value = b.close;
+            r.vwap.value = b.volume ? int64_t(b.turnover / b.volume) : b.close;
+            r.volume.value = b.volume;
+            buf.push_back(m);
+
+            r.part = bar_trades;
+            r.buy.value = b.buy;
+            r.sell.value = b.sell;
+            r.trades = b.trades;
+            buf.push_back(m);
+
+            b.trades = 0;
+            b.next = b.bucket + 1;
+            ++sent;
+        }
+        void add(const message_trade& t)
+        {
+            ++trades;
+            security& s = securities[t.security_id];
+            int64_t price = t.price.value, volume = t.count.value;
+            for(uint32_t p = 0; p != count; ++p) {
+                bar& b = s.b[p];
+                uint64_t bucket = t.time.value / periods[p];
+                //bar of this bucket already sent, late trade dropped
+                if(bucket < b.next) {
+                    ++late;
+                    continue;
+                }
+                //trade to other bucket before bar closed by timer
+                if(b.trades && b.bucket != bucket)
+                    send(t.security_id, periods[p], b);
+                if(!b.trades) {
+                    b.bucket = bucket;
+                    b.open = b.high = b.low = price;
+                    b.volume = b.buy = b.sell = 0;
+                    b.turnover = 0;
+                    if(!b.opened) {
+                        b.opened = true;
+                        opened[p].push_back(opened_bar(t.security_id, &b));
+                    }
+                }
+                b.high = std::max(b.high, price);
+                b.low = std::min(b.low, price);
+                b.close = price;
+                b.volume += volume;
+                b.turnover += __int128(price) * volume;
+                if(t.direction == 1)
+                    b.buy += volume;
+                else if(t.direction == 2)
+                    b.sell += volume;
+                ++b.trades;
+            }
+        }
+        void close(uint64_t time)
+        {
+            if(time < close_delay)
+                return;
+            for(uint32_t p = 0; p != count; ++p) {
+                uint64_t bucket = (time - close_delay) / periods[p];
+                if(bucket <= closed[p])
+                    continue;
+                closed[p] = bucket;
+                std::vector<opened_bar>& o = opened[p];
+                auto it = o.begin(), ie = o.end(), n = it;
+                for(; it != ie; ++it) {
+                    bar& b = *it->second;
+                    if(b.trades && b.bucket < bucket)
+                        send(it->first, periods[p], b);
+                    if(b.trades)
+                        *n++ = *it;
+                    else
+                        b.opened = false;
+                }
+                o.erase(n, ie);
+            }
+        }
+        void proceed(const message* m, uint32_t count)
+        {
+            buf.resize(1);
+            buf[0].t.time = get_export_mtime(m);
+            for(uint32_t i = 0; i != count; ++i, ++m) {
+                if(m->id == msg_trade)
+                    add(m->mt);
+                else if(m->id == msg_instr)
+                    buf.push_back(*m);
+            }
+            close(buf[0].t.time.value);
+            if(buf.size() > 1)
+                exp.proceed(&buf[1], buf.size() - 1);
+        }
+    };
+    void* bars_init(const char* params)
+    {
+        return new bars(params);
+    }
+    void bars_destroy(void* p)
+    {
+        delete (bars*)p;
+    }
+    void bars_proceed(void* p, const message* m, uint32_t count)
+    {
+        ((bars*)p)->proceed(m, count);
+    }
+    //consolidated books of same instrument from several exchanges, params: mappings exporter params,
+    //mapping name=security@exchange_id,security@exchange_id,... for every instrument,
+    //stream exported as is with derived security (exchange_id cons, security name) added,
+    //merged depth of all venues with total count of every price,
+    //level_id 2 * price for bids and 2 * price + 1 for asks, and attribution security (exchange_id cons_src)
+    //with levels 2 * venue + 1 and 2 * venue + 2, count of venue (position in mapping) at best bid and ask,
+    //changes sent at end of every batch
+    struct consolidated : noncopyable
+    {
+        static const uint32_t max_venues = 16;
+
+        struct instrument;
+        struct venue : price_book
+        {
+            instrument* parent;
+        };
+        struct instrument
+        {
+            //merged book and attribution of venues at its best prices
+            message_instr instr, src;
+            ttime_t time, etime;
+            bool announced, dirty;
+            price_book merged;
+            venue venues[max_venues];
+            uint32_t count;
+            //levels of merged book changed since last check, price and ask side
+            std::vector<std::pair<int64_t, bool> > changes;
+            int64_t prices[2 * max_venues], counts[2 * max_venues];
+        };
+
+        exporter exp;
+        std::deque<instrument> instruments;
+        //security@exchange_id
+        std::map<std::string, venue*> names;
+        std::unordered_map<uint32_t, venue*> securities;
+        std::vector<instrument*> dirty;
+        std::vector<message> buf;
+        uint64_t books, sent;
+
+        static std::string fixed(const char* s, uint32_t size)
+        {
+            return std::string(s, strnlen(s, size));
+        }
+        void add_instrument(const std::string& m)
+        {
+            auto e = std::find(m.begin(), m.end(), '=');
+            std::string name(m.begin(), e);
+            std::vector<std::string> vs = split(std::string(e + 1, m.end()), ',');
+            if(name.empty() || name.size() >= sizeof(message_instr::security) || vs.empty() || vs.size() > max_venues)
+                throw std::runtime_error(es() % "consolidated() bad mapping: " % m);
+
+            instruments.push_back(instrument());
+            instrument& i = instruments.back();
+            i.instr.id = msg_instr;
+            std::copy(name.begin(), name.end(), i.instr.security);
+            strcpy(i.instr.exchange_id, "cons");
+            i.instr.security_id = calc_crc(i.instr);
+            i.src = i.instr;
+            strcpy(i.src.exchange_id, "cons_src");
+            i.src.security_id = calc_crc(i.src);
+            for(const std::string& v: vs) {
+                if(std::find(v.begin(), v.end(), '@') == v.end() || !names.insert(std::make_pair(v, &i.venues[i.count])).second)
+                    throw std::runtime_error(es() % "consolidated() bad venue: " % v % ", mapping: " % m);
+                i.venues[i.count++].parent = &i;
+            }
+        }
+        consolidated(const std::string& params) : books(), sent()
+        {
+            mlog() << "consolidated() " << params;
+            std::vector<std::string> p = split(params, ' ');
+            uint32_t c = 0;
+            for(; c != p.size() && std::find(p[c].begin(), p[c].end(), '=') != p[c].end(); ++c)
+                add_instrument(p[c]);
+            if(!c || c == p.size())
+                throw std::runtime_error(es() % "consolidated() bad params: " % params);
+            std::string e = p[c];
+            for(++c; c != p.size(); ++c)
+                e = e + " " + p[c];
+            exp = exporter(e);
+            buf.reserve(16 * 1024);
+        }
+        ~consolidated()
+        {
+            mlog() << "~consolidated() books: " << books << ", sent: " << sent;
+        }
+        void update(instrument& i, const message_times& t)
+        {
+            i.time.value = std::max(i.time.value, t.time.value);
+            i.etime = t.etime;
+            if(!i.dirty) {
+                i.dirty = true;
+                dirty.push_back(&i);
+            }
+        }
+        void add(instrument& i, int64_t price, int64_t count, bool remove = false)
+        {
+            i.merged.add(price, count, remove);
+            if(count)
+                i.changes.push_back(std::make_pair(price, count < 0));
+        }
+        void clear(venue& v, const message_times& t)
+        {
+            for(auto& l: v.levels)
+                add(*v.parent, l.second.price, l.second.count, true);
+            v.clear();
+            update(*v.parent, t);
+        }
+        void apply(venue& v, const message_book& mb)
+        {
+            instrument& i = *v.parent;
+            auto it = v.levels.find(mb.level_id);
+            if(it != v.levels.end())
+                add(i, it->second.price, it->second.count, true);
+            v.set(mb);
+            it = v.levels.find(mb.level_id);
+            if(it != v.levels.end())
+                add(i, it->second.price, it->second.count);
+            update(i, mb);
+        }
+        void push(const instrument& i, uint32_t security_id, int64_t level_id, int64_t price, int64_t count)
+        {
+            message m = message();
+            message_book& b = m.mb;
+            b.time = i.time;
+            b.etime = i.etime;
+            b.id = msg_book;
+            b.security_id = security_id;
+            b.level_id = level_id;
+            b.price.value = price;
+            b.count.value = count;
+            buf.push_back(m);
+            ++sent;
+        }
+        //count of every venue at best price of merged side
+        template<typename side>
+        void push_src(instrument& i, uint32_t level, const side& merged, side price_book::*venue_side)
+        {
+            int64_t price = merged.empty() ? 0 : merged.begin()->first;
+            for(uint32_t v = 0; v != i.count; ++v, level += 2) {
+                const side& s = i.venues[v].*venue_side;
+                auto it = merged.empty() ? s.end() : s.find(price);
+                int64_t count = it == s.end() ? 0 : it->second;
+                if(count == i.counts[level] && (!count || price == i.prices[level]))
+                    continue;
+                if(count)
+                    i.prices[level] = price;
+                i.counts[level] = count;
+                push(i, i.src.security_id, level + 1, i.prices[level], count);
+            }
+        }
+        void check(instrument& i)
+        {
+            i.dirty = false;
+            if(!i.announced) {
+                i.announced = true;
+                i.instr.time = i.time;
+                i.src.time = i.time;
+                buf.push_back(reinterpret_cast<const message&>(i.instr));
+                buf.push_back(reinterpret_cast<const message&>(i.src));
+            }
+            //merged levels by price with total count, bid and ask of same price are different levels
+            std::sort(i.changes.begin(), i.changes.end());
+            i.changes.erase(std::unique(i.changes.begin(), i.changes.end()), i.changes.end());
+            for(auto& c: i.changes) {
+                int64_t count = 0;
+                if(c.second) {
+                    auto it = i.merged.asks.find(c.first);
+                    if(it != i.merged.asks.end())
+                        count = it->second;
+                }
+                else {
+                    auto it = i.merged.bids.find(c.first);
+                    if(it != i.merged.bids.end())
+                        count = it->second;
+                }
+                push(i, i.instr.security_id, c.first * 2 + c.second, c.first, count);
+            }
+            i.changes.clear();
+            push_src(i, 0, i.merged.bids, &venue::bids);
+            push_src(i, 1, i.merged.asks, &venue::asks);
+        }
+        void proceed(const message* m, uint32_t count)
+        {
+            buf.resize(1);
+            buf[0].t.time = get_export_mtime(m);
+            for(uint32_t i = 0; i != count; ++i, ++m) {
+                buf.push_back(*m);
+                if(m->id == msg_book) {
+                    auto it = securities.find(m->mb.security_id);
+                    if(it != securities.end()) {
+                        ++books;
+                        apply(*it->second, m->mb);
+                    }
+                }
+                else if(m->id == msg_clean) {
+                    auto it = securities.find(m->mc.security_id);
+                    if(it != securities.end())
+                        clear(*it->second, m->mc);
+                }
+                else if(m->id == msg_instr) {
+                    const message_instr& mi = m->mi;
+                    auto it = names.find(fixed(mi.security, sizeof(mi.security)) + "@" + fixed(mi.exchange_id, sizeof(mi.exchange_id)));
+                    if(it != names.end()) {
+                        securities[mi.security_id] = it->second;
+                        clear(*it->second, mi);
+                    }
+                }
+            }
+            for(instrument* i: dirty)
+                check(*i);
+            dirty.clear();
+            if(buf.size() > 1)
+                exp.proceed(&buf[1], buf.size() - 1);
+        }
+    };
+    void* consolidated_init(const char* params)
+    {
+        return new consolidated(params);
+    }
+    void consolidated_destroy(void* p)
+    {
+        delete (consolidated*)p;
+    }
+    void consolidated_proceed(void* p, const message* m, uint32_t count)
+    {
+        ((consolidated*)p)->proceed(m, count);
+    }
 }
 
 uint32_t register_exporter(const std::string& module, hole_exporter he)
@@ -342,5 +1563,12 @@ static const uint32_t register_log_message = register_exporter("log_messages", {
 static const uint32_t register_tyra = register_exporter("tyra", {&tyra_create, &tyra_destroy, &tyra_proceed});
 static const uint32_t register_pipe = register_exporter("pipe", {&pipe_init, &pipe_destroy, &pipe_proceed});
 static const uint32_t register_mmap = register_exporter("mmap_cp", {&mmap_init, &mmap_destroy, &mmap_proceed});
+static const uint32_t register_mcast = register_exporter("mcast", {&mcast_init, &mcast_destroy, &mcast_proceed});
+static const uint32_t register_snapshot = register_exporter("snapshot", {&snapshot_init, &snapshot_destroy, &snapshot_proceed});
+static const uint32_t register_query = register_exporter("query", {&query_init, &query_destroy, &query_proceed});
+static const uint32_t register_tob = register_exporter("tob", {&tob_init, &tob_destroy, &tob_proceed});
+static const uint32_t register_bbo = register_exporter("bbo", {&bbo_init, &bbo_destroy, &bbo_proceed});
+static const uint32_t register_bars = register_exporter("bars", {&bars_init, &bars_destroy, &bars_proceed});
+static const uint32_t register_consolidated = register_exporter("consolidated", {&consolidated_init, &consolidated_destroy, &consolidated_proceed});
 static const uint32_t register_null = register_exporter("/dev/null", {&hole_no_init, &hole_no_destroy, &hole_no_proceed});
 
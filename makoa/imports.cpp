@@ -4,12 +4,16 @@
 
 #include "mmap.hpp"
 #include "imports.hpp"
+#include "compact.hpp"
+#include "types.hpp"
 
 #include "evie/socket.hpp"
 
 #include <map>
 #include <atomic>
 #include <thread>
+#include <deque>
+#include <random>
 
 #include <sys/stat.h>
 
@@ -19,6 +23,8 @@ struct reader : noncopyable
     reader_state socket;
     typedef uint32_t (*func)(reader_state socket, char* buf, uint32_t buf_size);
     func read;
+    typedef void (*wfunc)(reader_state socket, const char* buf, uint32_t buf_size);
+    wfunc write;
 
     void* ctx;
     str_holder buf;
@@ -32,10 +38,16 @@ struct reader : noncopyable
         buf.size = readed;
         proceed_data(buf, ctx);
         recv_time = time(NULL);
+        message r;
+        if(unlikely(replay_request(ctx, r))) {
+            if(!write)
+                throw std::runtime_error("sequence gap and no retransmit channel");
+            write(socket, (const char*)&r, message_size);
+        }
         return true;
     }
-    reader(reader_state socket, func read) : socket(socket), read(read),
-        ctx(context_create()), buf(alloc_buffer()), recv_time(time(NULL)){
+    reader(reader_state socket, func read, wfunc write = nullptr, void* arbiter = nullptr) : socket(socket), read(read), write(write),
+        ctx(context_create(arbiter)), buf(alloc_buffer(ctx)), recv_time(time(NULL)){
     }
     ~reader() {
         free_buffer(buf, ctx);
@@ -187,14 +199,29 @@ struct import_pipe
     }
 };
 
-void work_thread_reader(reader<int>& r, volatile bool& can_run, uint32_t timeout/*in seconds*/)
+inline int reader_socket(int socket)
+{
+    return socket;
+}
+
+inline bool reader_buffered(int)
+{
+    return false;
+}
+
+template<typename reader_state>
+void work_thread_reader(reader<reader_state>& r, volatile bool& can_run, uint32_t timeout/*in seconds*/)
 {
     pollfd pfd = pollfd();
     pfd.events = POLLIN;
-    pfd.fd = r.socket;
+    pfd.fd = reader_socket(r.socket);
 
     while(can_run)
     {
+        if(unlikely(reader_buffered(r.socket))) {
+            r.proceed();
+            continue;
+        }
         int ret = poll(&pfd, 1, 50);
         if(ret < 0)
             throw_system_failure("poll() error");
@@ -225,28 +252,106 @@ void import_pipe_start(void* p)
     work_thread_reader(r, ip.can_run, timeout);
 }
 
+//tyra connection, first message selects plain or compact encoding
+struct tcp_stream : noncopyable
+{
+    int socket;
+    uint32_t head;
+    message first;
+    std::unique_ptr<compact::decoder> decoder;
+    char buf[64 * 1024];
+    const char *from, *to;
+    //decoding stopped by output buffer size
+    bool more;
+
+    tcp_stream(int socket) : socket(socket), head(), from(buf), to(buf), more()
+    {
+    }
+};
+
+inline int reader_socket(tcp_stream* s)
+{
+    return s->socket;
+}
+
+inline bool reader_buffered(tcp_stream* s)
+{
+    return s->more;
+}
+
+uint32_t tcp_read(tcp_stream* s, char* buf, uint32_t buf_size)
+{
+    if(likely(s->head == message_size && !s->decoder))
+        return socket_read(s->socket, buf, buf_size);
+
+    if(unlikely(s->head != message_size)) {
+        s->head += socket_read(s->socket, (char*)&s->first + s->head, message_size - s->head);
+        if(s->head != message_size)
+            return 0;
+        if(s->first.id != msg_compact) {
+            memcpy(buf, &s->first, message_size);
+            return message_size;
+        }
+        mlog() << "tyra compact encoding on socket " << s->socket;
+        s->decoder.reset(new compact::decoder());
+        return 0;
+    }
+
+    message* m = (message*)buf;
+    uint32_t max = buf_size / message_size, count = s->decoder->decode(s->from, s->to, m, max);
+    if(count != max) {
+        if(s->from != s->buf) {
+            memmove(s->buf, s->from, s->to - s->from);
+            s->to -= (s->from - s->buf);
+            s->from = s->buf;
+        }
+        s->to += socket_read(s->socket, s->buf + (s->to - s->buf), s->buf + sizeof(s->buf) - s->to);
+        count += s->decoder->decode(s->from, s->to, m + count, max - count);
+    }
+    s->more = (count == max);
+    return count * message_size;
+}
+
+void tcp_write(tcp_stream* s, const char* buf, uint32_t buf_size)
+{
+    socket_send_async(s->socket, buf, buf_size);
+}
+
+//params: port [arb], with arb all connections treated as redundant feeds of same instruments
 struct import_tcp
 {
     volatile bool& can_run;
     std::string params;
     uint16_t port;
+    void* arbiter;
+    uint32_t shard;
 
     uint32_t count;
     std::mutex mutex;
     std::condition_variable cond;
-    import_tcp(volatile bool& can_run, const std::string& params) : can_run(can_run), params(params), port(lexical_cast<uint16_t>(params)), count()
+    import_tcp(volatile bool& can_run, const std::string& params) : can_run(can_run), params(params), arbiter(),
+        shard(get_import_shard()), count()
     {
+        std::vector<std::string> p = split(params, ' ');
+        if(p.empty() || p.size() > 2 || (p.size() == 2 && p[1] != "arb"))
+            throw std::runtime_error(es() % "import_tcp() bad params: " % params);
+        port = lexical_cast<uint16_t>(p[0]);
+        if(p.size() == 2)
+            arbiter = arbiter_create(params.c_str());
     }
     ~import_tcp()
     {
         std::unique_lock<std::mutex> lock(mutex);
         while(count)
             cond.wait_for(lock, std::chrono::microseconds(50 * 1000));
+        if(arbiter)
+            arbiter_destroy(arbiter);
     }
 };
 
 void import_tcp_thread(import_tcp* it, int socket, std::string client, volatile bool& initialized)
 {
+    set_import_shard(it->shard);
     try {
         socket_holder ss(socket);
         std::unique_lock<std::mutex> lock(it->mutex);
@@ -259,7 +364,8 @@ void import_tcp_thread(import_tcp* it, int socket, std::string client, volatile
         it->cond.notify_all();
         lock.unlock();
         mlog() << "server() thread for " << client << " started";
-        reader<int> r(socket, socket_read);
+        tcp_stream ts(socket);
+        reader<tcp_stream*> r(&ts, tcp_read, tcp_write, it->arbiter);
         work_thread_reader(r, it->can_run, timeout);
     } catch(std::exception& e) {
         mlog(mlog::error) << "server(" << it->params << ") client " << client << " " << e;
@@ -289,6 +395,235 @@ void import_tcp_start(void* p)
     }
 }
 
+//receives datagrams from mcast exporter, params: group:port host:tcp_port
+//batches reordered by sequence numbers, gaps requested from exporter over tcp
+struct import_mcast
+{
+    //envelope and max 28 messages
+    static const uint32_t max_datagram = 29;
+
+    volatile bool& can_run;
+    std::string params;
+    std::string tcp_host;
+    uint16_t tcp_port;
+    int udp, tcp;
+
+    bool started, requested;
+    uint64_t expected, gaps, duplicates, reordered;
+    ttime_t request_time;
+    std::map<uint64_t, std::vector<message> > pending;
+    std::vector<char> stream;
+
+    import_mcast(volatile bool& can_run, const std::string& params) : can_run(can_run), params(params), udp(-1), tcp(-1)
+    {
+        std::vector<std::string> p = split(params, ' ');
+        if(p.size() != 2)
+            throw std::runtime_error(es() % "import_mcast() required 2 params (group:port host:tcp_port): " % params);
+        std::vector<std::string> g = split(p[0], ':'), h = split(p[1], ':');
+        if(g.size() != 2 || h.size() != 2)
+            throw std::runtime_error(es() % "import_mcast() bad params: " % params);
+        tcp_host = h[0];
+        tcp_port = lexical_cast<uint16_t>(h[1]);
+
+        udp = ::socket(AF_INET, SOCK_DGRAM, 0);
+        if(udp < 0)
+            throw_system_failure("import_mcast() open socket error");
+        int flag = 1, rcvbuf = 8 * 1024 * 1024;
+        if(setsockopt(udp, SOL_SOCKET, SO_REUSEADDR, &flag, sizeof(flag)) < 0)
+            throw_system_failure("import_mcast() set SO_REUSEADDR error");
+        if(setsockopt(udp, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf)) < 0)
+            throw_system_failure("import_mcast() set SO_RCVBUF error");
+        sockaddr_in addr = sockaddr_in();
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(lexical_cast<uint16_t>(g[1]));
+        addr.sin_addr.s_addr = htonl(INADDR_ANY);
+        if(bind(udp, (sockaddr*)&addr, sizeof(addr)) < 0)
+            throw_system_failure("import_mcast() bind() error");
+        ip_mreq mreq = ip_mreq();
+        if(inet_pton(AF_INET, g[0].c_str(), &mreq.imr_multiaddr) != 1)
+            throw std::runtime_error(es() % "import_mcast() bad group address: " % g[0]);
+        mreq.imr_interface.s_addr = htonl(INADDR_ANY);
+        if(setsockopt(udp, IPPROTO_IP, IP_ADD_MEMBERSHIP, &mreq, sizeof(mreq)) < 0)
+            throw_system_failure("import_mcast() IP_ADD_MEMBERSHIP error");
+    }
+    ~import_mcast()
+    {
+        ::close(udp);
+    }
+    void start()
+    {
+        tcp = socket_connect(tcp_host, tcp_port);
+        started = false;
+        requested = false;
+        expected = gaps = duplicates = reordered = 0;
+        pending.clear();
+        stream.clear();
+        mlog() << "import from " << params << " started";
+    }
+    void stop()
+    {
+        mlog() << "import from " << params << " stopped, seq: " << expected << ", gaps: " << gaps
+            << ", reordered: " << reordered << ", duplicates: " << duplicates;
+        ::close(tcp);
+        tcp = -1;
+    }
+
+    enum {duplicate, next, future};
+    //m points to envelope
+    uint32_t classify(const message* m, uint32_t size)
+    {
+        const message_seq& s = m->ms;
+        if(unlikely(m->id.id != msg_seq))
+            throw std::runtime_error(es() % "import_mcast() bad batch, msg_id: " % m->id.id);
+        if(unlikely(s.flags & seq_reset))
+            throw std::runtime_error(es() % "import_mcast() sequence " % expected % " out of exporter window, seq: " % s.seq);
+        if(unlikely(size != s.count + 1))
+            throw std::runtime_error(es() % "import_mcast() bad batch, size: " % size % ", count: " % s.count);
+        if(!started) {
+            started = true;
+            expected = s.seq;
+        }
+        if(s.seq + s.count <= expected) {
+            ++duplicates;
+            return duplicate;
+        }
+        if(s.seq <= expected && pending.empty())
+            return next;
+        return future;
+    }
+    void set_next(const message_seq& s)
+    {
+        expected = s.seq + s.count;
+        requested = false;
+    }
+    void add_pending(const message* m, uint32_t size)
+    {
+        pending[m->ms.seq].assign(m, m + size);
+    }
+    //moves pending batches to m while they are in order
+    uint32_t drain(message* m, uint32_t max)
+    {
+        uint32_t count = 0;
+        while(!pending.empty()) {
+            auto it = pending.begin();
+            const message_seq& s = it->second[0].ms;
+            if(s.seq > expected)
+                break;
+            if(s.seq + s.count > expected) {
+                if(count + it->second.size() > max)
+                    break;
+                std::copy(it->second.begin(), it->second.end(), m + count);
+                count += it->second.size();
+                set_next(s);
+            }
+            else
+                ++duplicates;
+            pending.erase(it);
+        }
+        return count;
+    }
+    void request()
+    {
+        ttime_t now = get_cur_ttime();
+        if(pending.empty() || (requested && now.value < request_time.value + ttime_t::frac / 10))
+            return;
+        message r;
+        r.ms = message_seq();
+        r.ms.time = now;
+        r.ms.id = msg_seq;
+        r.ms.seq = expected;
+        r.ms.count = pending.begin()->first - expected;
+        if(!requested) {
+            mlog(mlog::warning) << "import_mcast() gap, expected: " << expected << ", received: " << pending.begin()->first;
+            ++gaps;
+        }
+        requested = true;
+        request_time = now;
+        socket_send_async(tcp, (const char*)&r, message_size);
+    }
+    //replays from exporter
+    void proceed_stream()
+    {
+        char buf[64 * 1024];
+        int ret = ::recv(tcp, buf, sizeof(buf), MSG_DONTWAIT);
+        if(ret == -1 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            return;
+        if(ret <= 0)
+            throw_system_failure("import_mcast() side channel closed");
+        stream.insert(stream.end(), buf, buf + ret);
+        uint32_t from = 0;
+        while(stream.size() - from >= message_size) {
+            const message* m = (const message*)&stream[from];
+            uint32_t size = (m->ms.flags & seq_reset) ? 1 : m->ms.count + 1;
+            if(stream.size() - from < size * message_size)
+                break;
+            if(classify(m, size) != duplicate)
+                add_pending(m, size);
+            from += size * message_size;
+        }
+        stream.erase(stream.begin(), stream.begin() + from);
+    }
+};
+
+uint32_t mcast_read(void* v, char* buf, uint32_t buf_size)
+{
+    import_mcast& im = *((import_mcast*)v);
+    message* m = (message*)buf;
+    uint32_t max = buf_size / message_size, count = im.drain(m, max);
+    if(count)
+        return count * message_size;
+
+    pollfd pfd[2] = {pollfd(), pollfd()};
+    pfd[0].fd = im.udp;
+    pfd[0].events = POLLIN;
+    pfd[1].fd = im.tcp;
+    pfd[1].events = POLLIN;
+    int ret = poll(pfd, 2, 50);
+    if(ret < 0)
+        throw_system_failure("poll() error");
+    if(pfd[1].revents)
+        im.proceed_stream();
+    if(pfd[0].revents) {
+        while(max - count >= import_mcast::max_datagram) {
+            ret = ::recv(im.udp, (char*)(m + count), (max - count) * message_size, MSG_DONTWAIT);
+            if(ret == -1 && (errno == EAGAIN || errno == EWOULDBLOCK))
+                break;
+            if(ret < 0)
+                throw_system_failure("import_mcast() recv() error");
+            if(unlikely(!ret || ret % message_size))
+                throw std::runtime_error(es() % "import_mcast() bad datagram size: " % ret);
+            uint32_t size = ret / message_size, c = im.classify(m + count, size);
+            if(c == import_mcast::next) {
+                im.set_next(m[count].ms);
+                count += size;
+            }
+            else if(c == import_mcast::future) {
+                im.add_pending(m + count, size);
+                ++im.reordered;
+            }
+        }
+    }
+    count += im.drain(m + count, max - count);
+    im.request();
+    return count * message_size;
+}
+
+void import_mcast_start(void* p)
+{
+    import_mcast& im = *((import_mcast*)p);
+    im.start();
+    try {
+        reader<void*> r(p, &mcast_read);
+        while(im.can_run)
+            r.proceed();
+    }
+    catch(std::exception&) {
+        im.stop();
+        throw;
+    }
+    im.stop();
+}
+
 void* ifile_create(const char* params);
 void ifile_destroy(void *v);
 uint32_t ifile_read(void *v, char* buf, uint32_t buf_size);
@@ -326,6 +661,203 @@ void import_ifile_start(void* p)
     }
 }
 
+//generates books and trades of securities for load tests, params:
+//securities depth rate trades [seed [burst_period_ms burst_factor burst_ms]]
+//rate is book updates and trades is trades per second for all securities,
+//0 rate for max speed with trade after every 10 updates if trades not 0, such streams with same seed are same,
+//in first burst_ms of every burst_period_ms both rates multiplied by burst_factor,
+//every security starts with instr, clean and depth levels of both sides, mid price walks by one tick
+//on 2% of updates with book levels shifted
+struct import_synthetic
+{
+    static const int64_t tick = price_t::frac / 100;
+
+    struct security
+    {
+        uint32_t security_id;
+        int64_t mid;
+    };
+
+    volatile bool& can_run;
+    std::string params;
+    uint32_t depth, rate, trades, seed;
+    uint32_t burst_period, burst_factor, burst_ms;
+
+    std::mt19937_64 rnd;
+    std::vector<security> securities;
+    std::deque<message> pending;
+    ttime_t from, last;
+    double books_due, trades_due;
+    uint64_t books, trades_count;
+
+    import_synthetic(volatile bool& can_run, const std::string& params) : can_run(can_run), params(params), seed(),
+        burst_period(), burst_factor(1), burst_ms(), from(), last(), books_due(), trades_due(), books(), trades_count()
+    {
+        std::vector<std::string> p = split(params, ' ');
+        if(p.size() != 4 && p.size() != 5 && p.size() != 8)
+            throw std::runtime_error(es() % "import_synthetic() bad params: " % params);
+        uint32_t count = lexical_cast<uint32_t>(p[0]);
+        depth = lexical_cast<uint32_t>(p[1]);
+        rate = lexical_cast<uint32_t>(p[2]);
+        trades = lexical_cast<uint32_t>(p[3]);
+        if(!count || !depth || depth > 1000)
+            throw std::runtime_error(es() % "import_synthetic() bad securities or depth: " % params);
+        if(p.size() > 4)
+            seed = lexical_cast<uint32_t>(p[4]);
+        if(p.size() > 5) {
+            burst_period = lexical_cast<uint32_t>(p[5]);
+            burst_factor = lexical_cast<uint32_t>(p[6]);
+            burst_ms = lexical_cast<uint32_t>(p[7]);
+            if(!burst_period || burst_ms > burst_period)
+                throw std::runtime_error(es() % "import_synthetic() bad burst profile: " % params);
+        }
+        rnd.seed(seed);
+        for(uint32_t i = 0; i != count; ++i) {
+            message_instr mi = message_instr();
+            mi.id = msg_instr;
+            std::string exchange = "synth", feed = "syn", sec = "SYN";
+            sec += std::to_string(i);
+            std::copy(exchange.begin(), exchange.end(), mi.exchange_id);
+            std::copy(feed.begin(), feed.end(), mi.feed_id);
+            std::copy(sec.begin(), sec.end(), mi.security);
+            mi.security_id = calc_crc(mi);
+            securities.push_back({mi.security_id, int64_t(100 + rnd() % 10000) * price_t::frac});
+            add((const message&)mi);
+
+            message_clean mc = message_clean();
+            mc.id = msg_clean;
+            mc.security_id = mi.security_id;
+            add((const message&)mc);
+            for(uint32_t l = 1; l <= depth; ++l) {
+                add_level(securities.back(), securities.back().mid - l * tick, true);
+                add_level(securities.back(), securities.back().mid + l * tick, false);
+            }
+        }
+    }
+    void add(const message& m)
+    {
+        pending.push_back(m);
+    }
+    void add_level(const security& s, int64_t price, bool bid, bool remove = false)
+    {
+        message_book mb = message_book();
+        mb.id = msg_book;
+        mb.security_id = s.security_id;
+        mb.level_id = price;
+        mb.price.value = price;
+        if(!remove)
+            mb.count.value = int64_t(1 + rnd() % 100) * count_t::frac / 10 * (bid ? 1 : -1);
+        add((const message&)mb);
+    }
+    //best levels changed more often
+    uint32_t level()
+    {
+        uint32_t l = 1;
+        while(l < depth && rnd() % 3)
+            ++l;
+        return l;
+    }
+    void book_update()
+    {
+        security& s = securities[rnd() % securities.size()];
+        if(rnd() % 50) {
+            bool bid = rnd() % 2;
+            add_level(s, bid ? s.mid - level() * tick : s.mid + level() * tick, bid);
+        }
+        else if(rnd() % 2 || s.mid <= int64_t(depth + 1) * tick) {
+            //mid up, new best bid on old mid, best ask and deepest bid removed, new deepest ask
+            add_level(s, s.mid - depth * tick, true, true);
+            add_level(s, s.mid + tick, false, true);
+            add_level(s, s.mid, true);
+            s.mid += tick;
+            add_level(s, s.mid + depth * tick, false);
+        }
+        else {
+            add_level(s, s.mid + depth * tick, false, true);
+            add_level(s, s.mid - tick, true, true);
+            add_level(s, s.mid, false);
+            s.mid -= tick;
+            add_level(s, s.mid - depth * tick, true);
+        }
+    }
+    void trade()
+    {
+        security& s = securities[rnd() % securities.size()];
+        message_trade mt = message_trade();
+        mt.id = msg_trade;
+        mt.security_id = s.security_id;
+        mt.direction = 1 + rnd() % 2;
+        mt.price.value = (mt.direction == 1) ? s.mid + tick : s.mid - tick;
+        mt.count.value = int64_t(1 + rnd() % 20) * count_t::frac / 10;
+        add((const message&)mt);
+    }
+    //messages generated for time passed from previous call
+    void generate(uint32_t max)
+    {
+        ttime_t now = get_cur_ttime();
+        if(!rate) {
+            while(pending.size() < max) {
+                if(trades && !(books % 10)) {
+                    trade();
+                    ++trades_count;
+                }
+                book_update();
+                ++books;
+            }
+            return;
+        }
+        if(!from.value)
+            from = last = now;
+        uint32_t factor = 1;
+        if(burst_period && (now.value - from.value) / 1000000 % burst_period < burst_ms)
+            factor = burst_factor;
+        double dt = double(now.value - last.value) / ttime_t::frac * factor;
+        last = now;
+        books_due += dt * rate;
+        trades_due += dt * trades;
+        for(; books_due >= 1. && pending.size() < max; books_due -= 1., ++books)
+            book_update();
+        for(; trades_due >= 1. && pending.size() < max; trades_due -= 1., ++trades_count)
+            trade();
+    }
+    //fills buf with pending messages, times set on output
+    uint32_t read(char* buf, uint32_t buf_size)
+    {
+        uint32_t max = buf_size / message_size;
+        if(pending.size() < max)
+            generate(max);
+        if(pending.empty())
+            return 0;
+        ttime_t now = get_cur_ttime();
+        message* m = (message*)buf;
+        uint32_t count = std::min<uint32_t>(max, pending.size());
+        std::copy(pending.begin(), pending.begin() + count, m);
+        pending.erase(pending.begin(), pending.begin() + count);
+        for(uint32_t i = 0; i != count; ++i) {
+            m[i].t.time = now;
+            m[i].t.etime = now;
+        }
+        return count * message_size;
+    }
+};
+
+uint32_t synthetic_read(import_synthetic* s, char* buf, uint32_t buf_size)
+{
+    return s->read(buf, buf_size);
+}
+
+void import_synthetic_start(void* p)
+{
+    import_synthetic& s = *((import_synthetic*)(p));
+    mlog() << "synthetic import " << s.params << " started";
+    reader<import_synthetic*> r(&s, &synthetic_read);
+    while(s.can_run) {
+        if(!r.proceed() && s.rate)
+            usleep(100);
+    }
+    mlog() << "synthetic import " << s.params << " ended, generated books: " << s.books << ", trades: " << s.trades_count;
+}
+
 template<typename type>
 void* importer_init(volatile bool& can_run, const char* params)
 {
@@ -355,9 +887,15 @@ static const int _import_pipe = register_importer("pipe",
 static const int _import_tcp = register_importer("tyra",
     {importer_init<import_tcp>, importer_destroy<import_tcp>, import_tcp_start, nullptr}
 );
+static const int _import_mcast = register_importer("mcast",
+    {importer_init<import_mcast>, importer_destroy<import_mcast>, import_mcast_start, nullptr}
+);
 static const int _import_file = register_importer("file",
     {importer_init<import_ifile>, importer_destroy<import_ifile>, import_ifile_start, nullptr}
 );
+static const int _import_synthetic = register_importer("synthetic",
+    {importer_init<import_synthetic>, importer_destroy<import_synthetic>, import_synthetic_start, nullptr}
+);
 
 hole_importer create_importer(const char* name)
 {
@@ -4,14 +4,25 @@
 
 #pragma once
 
+#include "messages.hpp"
+
 #include "evie/string.hpp"
 #include "evie/utils.hpp"
 
-void* context_create();
+void* context_create(void* arbiter = nullptr);
 void context_destroy(void*);
-str_holder alloc_buffer();
+str_holder alloc_buffer(void* ctx);
 void free_buffer(str_holder buf, void* ctx);
 void proceed_data(str_holder& buf, void* ctx);
+//engine shard for contexts created by current thread, import is number of import in config
+void set_import_shard(uint32_t import);
+uint32_t get_import_shard();
+//shared state for first arrival arbitration of redundant feeds
+void* arbiter_create(const char* name);
+void arbiter_destroy(void* arbiter);
+
+//fills retransmit request for sequenced senders after gap detected in proceed_data()
+bool replay_request(void* ctx, message& m);
 
 struct hole_importer
 {
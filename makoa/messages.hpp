@@ -19,6 +19,9 @@ static const uint8_t
                         , msg_instr = 11
                         , msg_clean = 12
                         , msg_book  = 13
+                        , msg_seq   = 14
+                        , msg_compact = 15
+                        , msg_bar   = 16
 ;
 
 static const uint32_t message_size = 48, message_bsize = message_size - 17;
@@ -135,6 +138,64 @@ struct message_book : message_times
 };
 static_assert(sizeof(message_book) == message_size, "protocol agreement");
 
+//envelope of sequenced tyra (optional), pipe and mmap_cp batch, precedes count messages with numbers [seq, seq + count),
+//makoa sends it back with count 0 as retransmit request from seq,
+//sender answers with seq_reset flag if seq already out of its retransmit window
+static const uint32_t seq_reset = 1;
+struct message_seq : message_times
+{
+    uint8_t id;
+    uint8_t unused[7];
+
+    uint64_t seq;
+    uint32_t count;
+    uint32_t flags;
+    int64_t unused_;
+    static const uint32_t msg_id = msg_seq;
+};
+static_assert(sizeof(message_seq) == message_size, "protocol agreement");
+
+//aggregate of trades in [etime, time) by parser time, bar period is time - etime,
+//sent by bars exporter as three messages with same header in order bar_prices, bar_volumes, bar_trades
+static const uint8_t bar_prices = 0, bar_volumes = 1, bar_trades = 2;
+struct message_bar : message_times
+{
+    uint8_t id;
+    uint8_t part;
+    uint16_t unused;
+    uint32_t security_id;
+    union
+    {
+        struct
+        {
+            price_t open, high, low;
+        };
+        struct
+        {
+            price_t close, vwap;
+            count_t volume;
+        };
+        struct
+        {
+            count_t buy, sell; //volumes of trades with direction buy and sell
+            int64_t trades;
+        };
+    };
+    static const uint32_t msg_id = msg_bar;
+};
+static_assert(sizeof(message_bar) == message_size, "protocol agreement");
+
+//first message of tyra stream in compact encoding (makoa/compact.hpp), layout of message_ping,
+//not passed to makoa engine
+struct message_compact : message_times
+{
+    uint8_t id;
+    uint8_t unused[message_bsize];
+
+    static const uint32_t msg_id = msg_compact;
+};
+static_assert(sizeof(message_compact) == message_size, "protocol agreement");
+
 struct message
 {
     union
@@ -147,6 +208,8 @@ struct message
         message_instr mi;
         message_ping mp;
         message_hello dratuti;
+        message_seq ms;
+        message_bar mbar;
     };
 };
 
@@ -16,6 +16,8 @@ struct shared_memory_sync
 
 static const uint32_t mmap_alloc_size_base = message_size + (message_size - 2) * 255 * message_size;
 static const uint32_t mmap_alloc_size = mmap_alloc_size_base + sizeof(shared_memory_sync);
+//mapping rounded to 2MB hugepage, file on hugetlbfs mount (/dev/hugepages) mapped by hugepages
+static const uint32_t mmap_map_size = (mmap_alloc_size + (2 << 20) - 1) / (2 << 20) * (2 << 20);
 
 inline shared_memory_sync* get_smc(void* ptr)
 {
@@ -24,5 +26,5 @@ inline shared_memory_sync* get_smc(void* ptr)
 
 inline void mmap_close(void* ptr)
 {
-    munmap(ptr, mmap_alloc_size);
+    munmap(ptr, mmap_map_size);
 }
@@ -62,3 +62,49 @@ struct order_book
     typedef std::map<price_t, message_book>::const_iterator price_iterator;
 };
 
+//levels by level_id aggregated by price, positive counts for bids, negative for asks
+struct price_book
+{
+    struct level
+    {
+        int64_t price, count;
+    };
+    std::map<int64_t, level> levels;
+    std::map<int64_t, int64_t, std::greater<int64_t> > bids;
+    std::map<int64_t, int64_t> asks;
+
+    template<typename side>
+    static void add(side& s, int64_t price, int64_t count)
+    {
+        auto it = s.insert(std::make_pair(price, int64_t())).first;
+        it->second += count;
+        if(!it->second)
+            s.erase(it);
+    }
+    //sign of level count selects side, also for remove
+    void add(int64_t price, int64_t count, bool remove = false)
+    {
+        if(count > 0)
+            add(bids, price, remove ? -count : count);
+        else if(count < 0)
+            add(asks, price, remove ? -count : count);
+    }
+    void set(const message_book& mb)
+    {
+        level& l = levels[mb.level_id];
+        add(l.price, l.count, true);
+        if(mb.price.value)
+            l.price = mb.price.value;
+        l.count = mb.count.value;
+        add(l.price, l.count);
+        if(!l.count)
+            levels.erase(mb.level_id);
+    }
+    void clear()
+    {
+        levels.clear();
+        bids.clear();
+        asks.clear();
+    }
+};
+
@@ -0,0 +1,60 @@
+/*
+    binary protocol of makoa query exporter, export = query path [max_securities],
+    client connects to unix socket path and sends query_request,
+    exporter answers query_reply followed by count records
+
+    query_depth: query_book and bids then asks levels of security_id, best first, count 0 if not found
+    query_bbo: query_quote records for all securities of exchange_id (all if empty)
+
+    author: Ilya Andronov <sni4ok@yandex.ru>
+*/
+
+#pragma once
+
+#include "messages.hpp"
+
+static const uint32_t query_depth = 1, query_bbo = 2, query_max_depth = 20;
+
+struct query_request
+{
+    uint32_t type;
+    uint32_t security_id;
+    uint32_t depth;
+    char exchange_id[8];
+    uint32_t unused;
+};
+static_assert(sizeof(query_request) == 24, "protocol agreement");
+
+//count negative for asks, as in message_book
+struct query_level
+{
+    price_t price;
+    count_t count;
+};
+
+struct query_book
+{
+    ttime_t time;
+    uint32_t security_id;
+    uint32_t bids, asks;
+    char exchange_id[8];
+    uint32_t unused;
+};
+static_assert(sizeof(query_book) == 32, "protocol agreement");
+
+//query_bbo record, zero count for empty side
+struct query_quote
+{
+    ttime_t time;
+    uint32_t security_id;
+    uint32_t unused;
+    query_level bid, ask;
+};
+static_assert(sizeof(query_quote) == 48, "protocol agreement");
+
+struct query_reply
+{
+    uint32_t type;
+    uint32_t count;
+};
+
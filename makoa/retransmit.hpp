@@ -0,0 +1,105 @@
+/*
+    last messages of sequenced stream with message_seq envelopes,
+    kept by senders (tyra, mcast export) for replays on receiver gaps
+
+    author: Ilya Andronov <sni4ok@yandex.ru>
+*/
+
+#pragma once
+
+#include "messages.hpp"
+
+#include "evie/utils.hpp"
+
+#include <deque>
+#include <vector>
+#include <algorithm>
+
+class retransmit_window
+{
+    std::vector<message> history;
+    std::deque<std::pair<uint64_t, uint64_t> > batches; //seq, position in history
+    uint64_t seq, end;
+    uint32_t window;
+
+    void store(const message* m, uint32_t count)
+    {
+        while(count) {
+            uint32_t p = end % window, cnt = std::min(count, window - p);
+            std::copy(m, m + cnt, &history[p]);
+            m += cnt;
+            count -= cnt;
+            end += cnt;
+        }
+    }
+
+public:
+    retransmit_window(uint32_t window) : history(window), seq(), end(), window(window)
+    {
+        if(!window)
+            throw std::runtime_error("retransmit_window() zero window");
+    }
+    uint64_t get_seq() const
+    {
+        return seq;
+    }
+    uint64_t position() const
+    {
+        return end;
+    }
+    //stores envelope with count messages after it
+    void push(const message* m, uint32_t count, ttime_t time)
+    {
+        if(unlikely(count >= window))
+            throw std::runtime_error(es() % "retransmit_window::push() batch " % count % " not fit in window " % window);
+
+        message_seq s = message_seq();
+        s.time = time;
+        s.id = msg_seq;
+        s.seq = seq;
+        s.count = count;
+
+        batches.push_back(std::make_pair(seq, end));
+        store((const message*)&s, 1);
+        store(m, count);
+        seq += count;
+        while(end - batches.front().second > window)
+            batches.pop_front();
+    }
+    //position of batch contained message from, false if it already out of window
+    bool find(uint64_t from, uint64_t& pos) const
+    {
+        if(batches.empty() || batches.front().first > from || from > seq)
+            return false;
+        auto it = std::upper_bound(batches.begin(), batches.end(), std::make_pair(from, end));
+        pos = (--it)->second;
+        return true;
+    }
+    //position of first batch started from message to or later
+    uint64_t find_end(uint64_t to) const
+    {
+        auto it = std::lower_bound(batches.begin(), batches.end(), std::make_pair(to, uint64_t()));
+        return it == batches.end() ? end : it->second;
+    }
+    //calls f(const message* m, uint32_t count) for continuous parts of history [from, to)
+    template<typename func>
+    void read(uint64_t from, uint64_t to, func f) const
+    {
+        while(from != to) {
+            uint32_t p = from % window, cnt = std::min<uint64_t>(to - from, window - p);
+            f(&history[p], cnt);
+            from += cnt;
+        }
+    }
+    //answer for request out of window
+    message_seq reset(ttime_t time) const
+    {
+        message_seq r = message_seq();
+        r.time = time;
+        r.id = msg_seq;
+        r.seq = seq;
+        r.flags = seq_reset;
+        return r;
+    }
+};
+
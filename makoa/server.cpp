@@ -32,8 +32,9 @@ struct server::impl : stack_singleton<server::impl>
                 i.first.set_close(i.second);
         }
     }
-    void import_thread(std::string params)
+    void import_thread(std::string params, uint32_t import)
     {
+        set_import_shard(import);
         try
         {
             char* f = (char*)params.c_str();
@@ -65,12 +66,13 @@ struct server::impl : stack_singleton<server::impl>
     }
     void run()
     {
+        uint32_t import = 0;
         for(std::string i: config::instance().imports)
         {
             if(i.size() > 7 && std::equal(i.begin(), i.begin() + 7, "mmap_cp"))
                 i = i + (pooling_mode ? " 1" : " 0");
 
-            threads.push_back(std::thread(&impl::import_thread, this, i));
+            threads.push_back(std::thread(&impl::import_thread, this, i, import++));
         }
     }
     ~impl()
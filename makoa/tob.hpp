@@ -0,0 +1,229 @@
+/*
+    top of book publication, one writer (exporter thread) copies top levels of securities to seqlocked slots,
+    readers from any threads, or other processes for slots in shared memory (export = tob path),
+    copy slots without locks and never block writer
+
+    shared memory file: tob_header followed by max_securities slots of tob_depth levels,
+    slots filled in securities arrival order, header count released after slot security_id set,
+    restarted writer renames new file over path and marks old one stale, so readers reopen path
+
+    author: Ilya Andronov <sni4ok@yandex.ru>
+*/
+
+#pragma once
+
+#include "messages.hpp"
+#include "order_book.hpp"
+
+#include "evie/utils.hpp"
+#include "evie/socket.hpp"
+
+#include <atomic>
+#include <unordered_map>
+
+#include <stdio.h>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+static const uint32_t tob_depth = 20, tob_magic = 0x31626f74; //"tob1"
+
+//count negative for asks, as in message_book
+struct tob_level
+{
+    price_t price;
+    count_t count;
+};
+
+//single writer, readers copy data and retry if writer changed it meanwhile
+struct seqlock
+{
+    //odd while writer updates data
+    std::atomic<uint32_t> seq;
+
+    //f() updates data
+    template<typename func>
+    void write(func f)
+    {
+        uint32_t v = seq.load(std::memory_order_relaxed);
+        seq.store(v + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        f();
+        seq.store(v + 2, std::memory_order_release);
+    }
+    //f() copies data, repeated while writer updates it
+    template<typename func>
+    void read(func f) const
+    {
+        for(;;) {
+            uint32_t v = seq.load(std::memory_order_acquire);
+            if(v & 1) {
+                __builtin_ia32_pause();
+                continue;
+            }
+            f();
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if(seq.load(std::memory_order_relaxed) == v)
+                return;
+        }
+    }
+};
+
+template<uint32_t depth>
+struct tob_slot : seqlock
+{
+    uint32_t security_id;
+    uint32_t bids, asks;
+    char exchange_id[8];
+    //parser time of last book change
+    ttime_t time;
+    //last trade of security, zero id before first one
+    message_trade trade;
+    //bids from 0, asks from depth, best first
+    tob_level levels[2 * depth];
+
+    void publish(const price_book& b, ttime_t t)
+    {
+        write([&]() {
+            time = t;
+            uint32_t i = 0;
+            for(auto it = b.bids.begin(); it != b.bids.end() && i != depth; ++it, ++i)
+                levels[i] = tob_level{price_t{it->first}, count_t{it->second}};
+            bids = i;
+            i = 0;
+            for(auto it = b.asks.begin(); it != b.asks.end() && i != depth; ++it, ++i)
+                levels[depth + i] = tob_level{price_t{it->first}, count_t{it->second}};
+            asks = i;
+        });
+    }
+};
+
+typedef tob_slot<tob_depth> tob_shared_slot;
+static_assert(sizeof(tob_shared_slot) == 720, "protocol agreement");
+
+struct tob_header
+{
+    uint32_t magic;
+    uint32_t depth;
+    uint32_t max_securities;
+    uint32_t slot_size;
+    //filled slots
+    std::atomic<uint32_t> count;
+    //file replaced by restarted writer or writer ended
+    std::atomic<uint32_t> stale;
+    uint32_t unused[10];
+};
+static_assert(sizeof(tob_header) == 64, "protocol agreement");
+
+//writer creates file with create = true, readers map it read only
+class tob_map : noncopyable
+{
+    void* ptr;
+    uint64_t size;
+    bool writer;
+    std::unordered_map<uint32_t, const tob_shared_slot*> index;
+    uint32_t indexed;
+
+    void map(int h, const std::string& path)
+    {
+        ptr = mmap(nullptr, size, writer ? (PROT_READ | PROT_WRITE) : PROT_READ, MAP_SHARED | (writer ? MAP_POPULATE : 0), h, 0);
+        if(ptr == MAP_FAILED)
+            throw_system_failure(es() % "tob_map() mmap " % path % " error");
+        header = (tob_header*)ptr;
+        slots = (tob_shared_slot*)(header + 1);
+    }
+    static void set_stale(int h)
+    {
+        struct stat st;
+        if(fstat(h, &st) || uint64_t(st.st_size) < sizeof(tob_header))
+            return;
+        void* p = mmap(nullptr, sizeof(tob_header), PROT_READ | PROT_WRITE, MAP_SHARED, h, 0);
+        if(p == MAP_FAILED)
+            return;
+        tob_header* th = (tob_header*)p;
+        if(th->magic == tob_magic)
+            th->stale.store(1, std::memory_order_release);
+        munmap(p, sizeof(tob_header));
+    }
+    //readers of old file keep their mapping, truncating it would SIGBUS them
+    void create(const std::string& path, uint32_t max_securities)
+    {
+        std::string tmp = path + ".tmp";
+        int h = ::open(tmp.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0666);
+        if(h < 0)
+            throw_system_failure(es() % "tob_map() open " % tmp % " error");
+        socket_holder sh(h);
+        size = sizeof(tob_header) + uint64_t(max_securities) * sizeof(tob_shared_slot);
+        if(ftruncate(h, size))
+            throw_system_failure(es() % "tob_map() ftruncate " % tmp % " error");
+        map(h, tmp);
+        header->depth = tob_depth;
+        header->max_securities = max_securities;
+        header->slot_size = sizeof(tob_shared_slot);
+        header->count.store(0, std::memory_order_relaxed);
+        header->stale.store(0, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        header->magic = tob_magic;
+
+        int old = ::open(path.c_str(), O_RDWR);
+        int r = rename(tmp.c_str(), path.c_str());
+        if(old >= 0) {
+            if(!r)
+                set_stale(old);
+            ::close(old);
+        }
+        if(r)
+            throw_system_failure(es() % "tob_map() rename " % tmp % " to " % path % " error");
+    }
+    void open(const std::string& path)
+    {
+        int h = ::open(path.c_str(), O_RDONLY);
+        if(h < 0)
+            throw_system_failure(es() % "tob_map() open " % path % " error");
+        socket_holder sh(h);
+        tob_header th;
+        if(::read(h, &th, sizeof(th)) != sizeof(th) || th.magic != tob_magic || th.depth != tob_depth
+            || th.slot_size != sizeof(tob_shared_slot))
+            throw std::runtime_error(es() % "tob_map() " % path % " bad header");
+        size = sizeof(tob_header) + uint64_t(th.max_securities) * sizeof(tob_shared_slot);
+        map(h, path);
+    }
+
+public:
+    tob_header* header;
+    tob_shared_slot* slots;
+
+    tob_map(const std::string& path, bool create, uint32_t max_securities = 0) : ptr(MAP_FAILED), size(), writer(create), indexed()
+    {
+        if(create)
+            this->create(path, max_securities);
+        else
+            open(path);
+    }
+    //nullptr if security not published yet, slots added to index on miss
+    const tob_shared_slot* find(uint32_t security_id)
+    {
+        auto it = index.find(security_id);
+        if(it != index.end())
+            return it->second;
+        for(uint32_t c = header->count.load(std::memory_order_acquire); indexed != c; ++indexed)
+            index[slots[indexed].security_id] = &slots[indexed];
+        it = index.find(security_id);
+        return it == index.end() ? nullptr : it->second;
+    }
+    //reader should map path again
+    bool stale() const
+    {
+        return header->stale.load(std::memory_order_acquire);
+    }
+    ~tob_map()
+    {
+        if(ptr != MAP_FAILED) {
+            if(writer)
+                header->stale.store(1, std::memory_order_release);
+            munmap(ptr, size);
+        }
+    }
+};
@@ -79,6 +79,20 @@ stream& operator<<(stream& s, const message_book& t)
     return s;
 }
 
+template<typename stream>
+stream& operator<<(stream& s, const message_bar& b)
+{
+    s << "bar|" << b.security_id << "|" << uint32_t(b.part) << "|";
+    if(b.part == bar_prices)
+        s << b.open << "|" << b.high << "|" << b.low;
+    else if(b.part == bar_volumes)
+        s << b.close << "|" << b.vwap << "|" << b.volume;
+    else
+        s << b.buy << "|" << b.sell << "|" << b.trades;
+    s << "|" << b.etime << "|" << b.time << "|";
+    return s;
+}
+
 template<typename stream>
 stream& operator<<(stream& s, const message_ping& p)
 {
@@ -7,9 +7,22 @@
 #include "evie/socket.hpp"
 #include "evie/time.hpp"
 
-tyra::tyra(const std::string& host) : send_from_call(), send_from_buffer(), bf(buf), bt(buf + sizeof(buf)), c(buf), e(buf) 
+tyra::tyra(const std::string& params) : send_from_call(), send_from_buffer(), bf(buf), bt(buf + sizeof(buf)), c(buf), e(buf),
+    replays(), request_size(), batches(), encoded_from(), encoded_to()
 {
-    mlog() << "tyra() " << host;
+    mlog() << "tyra() " << params;
+    std::vector<std::string> p = split(params, ' ');
+    if(p.empty() || p.size() > 3)
+        throw std::runtime_error(es() % "tyra::tyra() bad params: " % params);
+    const std::string& host = p[0];
+    for(auto it = p.begin() + 1; it != p.end(); ++it) {
+        if(*it == "compact")
+            encoder.reset(new compact::encoder());
+        else if(!history)
+            history.reset(new retransmit_window(lexical_cast<uint32_t>(*it)));
+        else
+            throw std::runtime_error(es() % "tyra::tyra() bad params: " % params);
+    }
     auto ie = host.end(), i = std::find(host.begin(), ie, ':');
     if(i == ie || i + 1 == ie)
         throw std::runtime_error(es() % "tyra::tyra() bad host: " % host);
@@ -18,20 +31,38 @@ tyra::tyra(const std::string& host) : send_from_call(), send_from_buffer(), bf(b
     std::string port(i + 1, host.end());
     socket = socket_connect(h.c_str(), atoi(port.c_str()));
     mlog() << "tyra() connected to socket " << socket;
+    if(encoder) {
+        message_compact mc = message_compact();
+        mc.time = get_cur_ttime();
+        mc.id = msg_compact;
+        socket_send(socket, (const char*)&mc, message_size);
+    }
 }
 
 tyra::~tyra()
 {
     mlog() << "~tyra() sfc: " << send_from_call << ", sfb: " << send_from_buffer;
+    if(history)
+        mlog() << "~tyra() seq: " << history->get_seq() << ", replays: " << replays;
+    if(encoder)
+        mlog() << "~tyra() compact from: " << encoded_from << ", to: " << encoded_to;
     close(socket);
 }
 
 void tyra::send(const message& m)
 {
+    if(history) {
+        send_seq(&m, 1);
+        return;
+    }
+    if(encoder) {
+        send_raw(&m, 1);
+        return;
+    }
     const char* ptr = (const char*)(&m);
     const uint32_t sz = message_size;
     if(c != e) {
-        if(unlikely(bt - e > sz))
+        if(unlikely(bt - e < sz))
             throw std::runtime_error("tyra::send() message buffer overloaded");
         std::copy(ptr, ptr + sz, e);
         e += sz;
@@ -56,10 +87,39 @@ void tyra::send(const message& m)
 
 void tyra::send(const message* m, uint32_t count)
 {
-    const char* ptr = (const char*)(m);
-    const uint32_t sz = count * message_size;
+    if(history)
+        send_seq(m, count);
+    else
+        send_raw(m, count);
+}
+
+template<typename func>
+void tyra::write(const message* m, uint32_t count, func f)
+{
+    if(!encoder) {
+        f((const char*)m, count * message_size);
+        return;
+    }
+    char out[256 * compact::max_size];
+    while(count) {
+        uint32_t cnt = std::min<uint32_t>(count, 256), sz = encoder->encode(m, cnt, out);
+        encoded_from += cnt * message_size;
+        encoded_to += sz;
+        f(out, sz);
+        m += cnt;
+        count -= cnt;
+    }
+}
+
+void tyra::send_raw(const message* m, uint32_t count)
+{
+    write(m, count, [this](const char* ptr, uint32_t sz) {send_bytes(ptr, sz);});
+}
+
+void tyra::send_bytes(const char* ptr, uint32_t sz)
+{
     if(c != e) {
-        if(unlikely(bt - e > sz))
+        if(unlikely(bt - e < sz))
             throw std::runtime_error("tyra::send() messages buffer overloaded");
         std::copy(ptr, ptr + sz, e);
         e += sz;
@@ -84,3 +144,50 @@ void tyra::flush()
     }
 }
 
+
+void tyra::send_seq(const message* m, uint32_t count)
+{
+    if(c != e || !(++batches % requests_period))
+        check_requests();
+    uint64_t from = history->position();
+    history->push(m, count, get_cur_ttime());
+    history->read(from, history->position(), [this](const message* m, uint32_t count) {send_raw(m, count);});
+}
+
+void tyra::check_requests()
+{
+    for(;;) {
+        int ret = ::recv(socket, (char*)&request + request_size, message_size - request_size, MSG_DONTWAIT);
+        if(ret == -1 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            return;
+        else if(ret == 0)
+            throw_system_failure("socket closed");
+        else if(ret < 0)
+            throw_system_failure("recv() error");
+        request_size += ret;
+        if(request_size != message_size)
+            continue;
+        request_size = 0;
+        if(unlikely(request.id.id != msg_seq))
+            throw std::runtime_error(es() % "tyra::check_requests() bad msg_id: " % request.id.id);
+        replay(request.ms.seq);
+    }
+}
+
+void tyra::replay(uint64_t from)
+{
+    flush();
+    uint64_t pos;
+    if(!history->find(from, pos)) {
+        mlog(mlog::critical) << "tyra::replay() from " << from << " out of window, seq: " << history->get_seq();
+        message_seq r = history->reset(get_cur_ttime());
+        socket_send_async(socket, (const char*)&r, message_size);
+        return;
+    }
+    mlog(mlog::warning) << "tyra::replay() from " << from << ", seq: " << history->get_seq();
+    ++replays;
+    history->read(pos, history->position(), [this](const message* m, uint32_t count) {
+        write(m, count, [this](const char* ptr, uint32_t sz) {socket_send_async(socket, ptr, sz);});
+    });
+}
+
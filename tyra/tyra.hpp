@@ -5,9 +5,13 @@
 #pragma once
 
 #include "makoa/messages.hpp"
+#include "makoa/retransmit.hpp"
+#include "makoa/compact.hpp"
 
 #include "evie/utils.hpp"
 
+#include <memory>
+
 class tyra
 {
     uint64_t send_from_call, send_from_buffer;
@@ -20,8 +24,32 @@ class tyra
     tyra(const tyra&) = delete;
     message_ping mp;
 
+    //sequenced mode, enabled by window param, every batch preceded by message_seq
+    //and last window messages kept for retransmit by makoa requests
+    std::unique_ptr<retransmit_window> history;
+    uint64_t replays;
+    message request;
+    uint32_t request_size, batches;
+
+    //compact mode, enabled by compact param
+    std::unique_ptr<compact::encoder> encoder;
+    uint64_t encoded_from, encoded_to;
+
+    //calls f(const char* ptr, uint32_t sz) for messages in wire format
+    template<typename func>
+    void write(const message* m, uint32_t count, func f);
+
+    void send_bytes(const char* ptr, uint32_t sz);
+    void send_raw(const message* m, uint32_t count);
+    void send_seq(const message* m, uint32_t count);
+    //requests polled when send would block or every requests_period batches
+    static const uint32_t requests_period = 64;
+    void check_requests();
+    void replay(uint64_t from);
+
 public:
-    tyra(const std::string& host);
+    //host:port [window] [compact]
+    tyra(const std::string& params);
 
     void send(const message& m);
     void send(const message* m, uint32_t count);
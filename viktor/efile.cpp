@@ -108,6 +108,17 @@ struct efile
         bs << "i," <<  m.exchange_id << ',' << m.feed_id << ',' << m.security_id
             << ',' << m.time << '\n';
     }
+    void write_csv(const message_bar& m)
+    {
+        bs << "bar," <<  m.security_id << ',' << uint32_t(m.part) << ',';
+        if(m.part == bar_prices)
+            bs << m.open << ',' << m.high << ',' << m.low;
+        else if(m.part == bar_volumes)
+            bs << m.close << ',' << m.vwap << ',' << m.volume;
+        else
+            bs << m.buy << ',' << m.sell << ',' << m.trades;
+        bs << ',' << m.etime << ',' << m.time << '\n';
+    }
     void proceed_csv(const message* m, uint32_t count)
     {
         for(uint32_t i = 0; i != count; ++i, ++m) {
@@ -120,6 +131,8 @@ struct efile
             else if(m->id == msg_instr) {
                 write_csv((message_instr&)*m);
             }
+            else if(m->id == msg_bar)
+                write_csv((message_bar&)*m);
         }
         flush();
     }
@@ -22,7 +22,7 @@ struct config : stack_singleton<config>
 
 #include "alco/main.hpp"
 
-void* context_create()
+void* context_create(void*)
 {
     exporter* e = new exporter(config::instance().push);
     return (void*)e;
@@ -34,7 +34,7 @@ void context_destroy(void* e)
 
 char msg_buf[message_size * 256];
 
-str_holder alloc_buffer()
+str_holder alloc_buffer(void*)
 {
     return str_holder(msg_buf + 1, 255 * message_size);
 }
@@ -50,10 +50,38 @@ void proceed_data(str_holder& buf, void* ctx)
     uint32_t count = buf.size / message_size;
     if(unlikely(buf.size % message_size))
         throw std::runtime_error("fractional messages not supported yet");
-    e->proceed(m, count);
+    //envelopes of incoming batches dropped, exporter sequences its own batches
+    count = std::remove_if(m, m + count, [](const message& v) {return v.id == msg_seq;}) - m;
+    if(count)
+        e->proceed(m, count);
     buf.size = 255 * message_size;
 }
 
+//pip has one exporter for all imports
+void set_import_shard(uint32_t)
+{
+}
+
+uint32_t get_import_shard()
+{
+    return 0;
+}
+
+void* arbiter_create(const char*)
+{
+    throw std::runtime_error("pip not supports feeds arbitration");
+}
+
+void arbiter_destroy(void*)
+{
+}
+
+//pip forwards sequenced batches without gap detection
+bool replay_request(void*, message&)
+{
+    return false;
+}
+
 void proceed_pip(volatile bool& can_run)
 {
     char* f = (char*)config::instance().import.c_str();
@@ -0,0 +1,434 @@
+/*
+    end to end latency benchmark of makoa transports, replaces tests/make_one.lua and make_zero.lua,
+    usage: ./pipeline_bench [config file], see configs/pipeline_bench.conf
+
+    every topology is chain of links (tyra, pipe or mmap_cp), n links connect synthetic parser,
+    n - 1 makoa_server processes and sink, sink and taps importers are running in this process,
+    every server also exports copy of stream to own tap by tyra (taps = 1),
+    so per hop latency is difference between neighbor taps,
+    latency of message measured from parser time (message::t.time) to sink arrival,
+    export mtime of sink buffers not comes through wire and not used
+
+    author: Ilya Andronov <sni4ok@yandex.ru>
+*/
+
+#include "evie/utils.hpp"
+#include "evie/mfile.hpp"
+#include "evie/config.hpp"
+
+#include "makoa/exports.hpp"
+#include "makoa/imports.hpp"
+
+#include <thread>
+
+#include <signal.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+struct config : stack_singleton<config>
+{
+    std::string makoa, dir;
+    std::vector<std::string> topologies;
+    uint16_t port;
+    uint32_t messages, rate, batch, securities;
+    uint32_t startup_ms, timeout;
+    bool taps, pooling;
+
+    config(const char* fname)
+    {
+        std::string cs = read_file<std::string>(fname);
+        makoa = get_config_param<std::string>(cs, "makoa", true, "./makoa_server");
+        dir = get_config_param<std::string>(cs, "dir", true, "/tmp/pipeline_bench");
+        topologies = get_config_params<std::string>(cs, "topology");
+        if(topologies.empty())
+            throw std::runtime_error("config() at least one topology required");
+        port = get_config_param<uint16_t>(cs, "port", true, 31000);
+        messages = get_config_param<uint32_t>(cs, "messages", true, 1000000);
+        rate = get_config_param<uint32_t>(cs, "rate", true, 100000);
+        batch = get_config_param<uint32_t>(cs, "batch", true, 10);
+        if(!batch || batch > 150)
+            throw std::runtime_error(es() % "config() batch should be in [1, 150]: " % batch);
+        securities = get_config_param<uint32_t>(cs, "securities", true, 100);
+        if(!securities)
+            throw std::runtime_error("config() zero securities");
+        startup_ms = get_config_param<uint32_t>(cs, "startup_ms", true, 300);
+        timeout = get_config_param<uint32_t>(cs, "timeout", true, 10);
+        taps = get_config_param<bool>(cs, "taps", true, true);
+        pooling = get_config_param<bool>(cs, "pooling", true);
+
+        mlog ml;
+        ml << "config() makoa: " << makoa << ", dir: " << dir << ", port: " << port << ", messages: " << messages
+            << ", rate: " << rate << ", batch: " << batch << ", securities: " << securities << ", taps: " << taps
+            << ", pooling: " << pooling;
+        for(auto& t: topologies)
+            ml << "\n    topology: " << t;
+    }
+};
+
+#include "alco/main.hpp"
+#include "alco/alco.hpp"
+
+namespace
+{
+    //arrivals of one sink or tap importer
+    struct channel
+    {
+        std::atomic<uint64_t> count;
+        uint64_t first, last;
+        std::vector<uint64_t> latencies;
+
+        channel(uint32_t messages) : count(), first(), last()
+        {
+            latencies.reserve(messages);
+        }
+        void add(const message* m, uint32_t cnt)
+        {
+            uint64_t now = get_cur_ttime().value;
+            uint64_t c = 0;
+            for(const message* e = m + cnt; m != e; ++m) {
+                if(m->id == msg_book || m->id == msg_trade) {
+                    latencies.push_back(now - m->t.time.value);
+                    ++c;
+                }
+            }
+            if(c) {
+                if(!first)
+                    first = now;
+                last = now;
+                count += c;
+            }
+        }
+    };
+
+    std::vector<std::unique_ptr<channel> > channels;
+
+    //importer context, tcp stream can be cut on any byte, so tail of partial message kept for next read
+    struct sink_context
+    {
+        channel* ch;
+        uint32_t tail;
+        message buf[256];
+
+        sink_context(channel* ch) : ch(ch), tail()
+        {
+        }
+    };
+}
+
+void* context_create(void*)
+{
+    return new sink_context(channels.at(get_import_shard()).get());
+}
+
+void context_destroy(void* ctx)
+{
+    delete (sink_context*)ctx;
+}
+
+str_holder alloc_buffer(void* ctx)
+{
+    sink_context* c = (sink_context*)ctx;
+    return str_holder((const char*)(c->buf + 1), 255 * message_size);
+}
+
+void free_buffer(str_holder, void*)
+{
+}
+
+void proceed_data(str_holder& buf, void* ctx)
+{
+    sink_context* c = (sink_context*)ctx;
+    char* from = (char*)(c->buf + 1);
+    uint32_t size = c->tail + buf.size, count = size / message_size;
+    c->ch->add((const message*)from, count);
+    c->tail = size % message_size;
+    if(c->tail)
+        memmove(from, from + count * message_size, c->tail);
+    buf.str = from + c->tail;
+    buf.size = 255 * message_size - c->tail;
+}
+
+//channel of importer is chosen by shard of thread created it
+static thread_local uint32_t import_shard;
+
+void set_import_shard(uint32_t import)
+{
+    import_shard = import;
+}
+
+uint32_t get_import_shard()
+{
+    return import_shard;
+}
+
+void* arbiter_create(const char*)
+{
+    throw std::runtime_error("pipeline_bench not supports feeds arbitration");
+}
+
+void arbiter_destroy(void*)
+{
+}
+
+bool replay_request(void*, message&)
+{
+    return false;
+}
+
+namespace
+{
+    struct link
+    {
+        std::string type, import, export_;
+    };
+
+    //import and export params of link, files of pipe and mmap_cp placed in dir
+    link make_link(const std::string& type, const std::string& name, uint16_t port)
+    {
+        const config& cfg = config::instance();
+        if(type == "tyra")
+            return {type, "tyra " + std::to_string(port), "tyra 127.0.0.1:" + std::to_string(port)};
+        std::string fname = cfg.dir + "/" + name;
+        if(type == "pipe")
+            return {type, "pipe " + fname + ".pipe", "pipe " + fname + ".pipe"};
+        if(type == "mmap_cp")
+            return {type, "mmap_cp " + fname + ".mmap", "mmap_cp " + fname + ".mmap"};
+        throw std::runtime_error(es() % "pipeline_bench unsupported link: " % type);
+    }
+
+    struct importer_thread
+    {
+        volatile bool can_run;
+        hole_importer hi;
+        void* i;
+        std::thread thrd;
+
+        importer_thread(const std::string& params, uint32_t ch) : can_run(true), i()
+        {
+            std::vector<std::string> p = split(params, ' ');
+            std::string args = params.substr(p[0].size() + 1);
+            //as makoa server does
+            if(p[0] == "mmap_cp")
+                args = args + (config::instance().pooling ? " 1" : " 0");
+            hi = create_importer(p[0].c_str());
+            set_import_shard(ch);
+            i = hi.init(can_run, args.c_str());
+            thrd = std::thread(&importer_thread::run, this, ch, params);
+        }
+        void run(uint32_t ch, std::string params)
+        {
+            set_import_shard(ch);
+            try {
+                hi.start(i);
+            } catch(std::exception& e) {
+                if(can_run)
+                    mlog(mlog::warning) << "pipeline_bench importer " << params << " " << e;
+            }
+        }
+        ~importer_thread()
+        {
+            can_run = false;
+            if(hi.set_close)
+                hi.set_close(i);
+            thrd.join();
+            hi.destroy(i);
+        }
+    };
+
+    struct makoa_process
+    {
+        pid_t pid;
+
+        makoa_process(const std::string& conf) : pid(fork())
+        {
+            if(pid < 0)
+                throw_system_failure("fork() error");
+            if(!pid) {
+                int n = ::open("/dev/null", O_WRONLY);
+                dup2(n, 1);
+                dup2(n, 2);
+                execl(config::instance().makoa.c_str(), config::instance().makoa.c_str(), conf.c_str(), (char*)nullptr);
+                _exit(127);
+            }
+        }
+        void check()
+        {
+            int status = 0;
+            if(waitpid(pid, &status, WNOHANG) == pid) {
+                pid = 0;
+                throw std::runtime_error(es() % "pipeline_bench makoa_server ended with status " % status);
+            }
+        }
+        ~makoa_process()
+        {
+            if(!pid)
+                return;
+            kill(pid, SIGTERM);
+            int status = 0;
+            waitpid(pid, &status, 0);
+            if(!WIFEXITED(status) || WEXITSTATUS(status))
+                mlog(mlog::warning) << "pipeline_bench makoa_server pid " << pid << " ended with status " << status;
+        }
+    };
+
+    void write_conf(const std::string& fname, const std::string& name, const std::string& import, const std::vector<std::string>& exports)
+    {
+        std::string cs = "name = " + name + "\nexport_threads = " + std::to_string(exports.size())
+            + "\npooling = " + std::to_string(config::instance().pooling) + "\nimport = " + import + "\n";
+        for(auto& e: exports)
+            cs += "export = " + e + "\n";
+        std::ofstream f(fname, std::ios::trunc);
+        f << cs;
+        if(!f)
+            throw std::runtime_error(es() % "write \"" % fname % "\" error");
+    }
+
+    //synthetic parser, books of securities with changing levels and trades on every 8-th message
+    void proceed_source(const std::string& push, volatile bool& can_run)
+    {
+        const config& cfg = config::instance();
+        std::unique_ptr<emessages> e;
+        uint64_t wait_to = get_cur_ttime().value + uint64_t(cfg.startup_ms) * 1000000 * 10;
+        while(!e) {
+            try {
+                e = std::make_unique<emessages>(push);
+            } catch(std::exception&) {
+                if(get_cur_ttime().value > wait_to || !can_run)
+                    throw;
+                usleep(10000);
+            }
+        }
+        std::vector<security> secs(cfg.securities);
+        for(uint32_t i = 0; i != cfg.securities; ++i) {
+            secs[i].init("bench", "pb", std::string("S") += std::to_string(i));
+            secs[i].proceed_instr(e->e, get_cur_ttime());
+        }
+
+        uint64_t from = get_cur_ttime().value;
+        for(uint32_t i = 0; i != cfg.messages && can_run; ) {
+            if(cfg.rate) {
+                uint64_t at = from + uint64_t(i) * ttime_t::frac / cfg.rate;
+                while(get_cur_ttime().value < at)
+                    ;
+            }
+            for(uint32_t b = 0; b != cfg.batch && i != cfg.messages; ++b, ++i) {
+                ttime_t time = get_cur_ttime();
+                uint32_t security_id = secs[i % cfg.securities].mi.security_id;
+                price_t price = {int64_t(100000000 + (i % 20) * 1000000)};
+                count_t count = {int64_t((i % 7 + 1) * 100000000)};
+                if(i % 8 == 7)
+                    e->add_trade(security_id, price, count, i % 2 + 1, time, time);
+                else
+                    e->add_order(security_id, price.value, price, (i % 16 > 7) ? count : count_t{-count.value}, time, time);
+            }
+            e->flush();
+        }
+        mlog() << "pipeline_bench source sent " << cfg.messages << " messages in "
+            << (get_cur_ttime().value - from) / 1000000 << "ms";
+    }
+
+    struct percentiles
+    {
+        uint64_t p50, p90, p99, p999, max;
+
+        percentiles(std::vector<uint64_t>& v) : p50(), p90(), p99(), p999(), max()
+        {
+            if(v.empty())
+                return;
+            std::sort(v.begin(), v.end());
+            auto pc = [&v](double p) {
+                return v[std::min<uint64_t>(v.size() - 1, uint64_t(v.size() * p))];
+            };
+            p50 = pc(0.5), p90 = pc(0.9), p99 = pc(0.99), p999 = pc(0.999), max = v.back();
+        }
+    };
+
+    mlog& operator<<(mlog& ml, const percentiles& p)
+    {
+        return ml << "p50: " << p.p50 / 1000 << "us, p90: " << p.p90 / 1000 << "us, p99: " << p.p99 / 1000
+            << "us, p99.9: " << p.p999 / 1000 << "us, max: " << p.max / 1000 << "us";
+    }
+
+    void run_topology(const std::string& topology, uint32_t idx, volatile bool& can_run)
+    {
+        const config& cfg = config::instance();
+        std::vector<std::string> types = split(topology, ' ');
+        uint32_t servers = types.size() - 1;
+        uint16_t port = cfg.port + idx * 64;
+        if(types.size() > 32)
+            throw std::runtime_error(es() % "pipeline_bench too long topology: " % topology);
+
+        std::vector<link> links;
+        for(uint32_t i = 0; i != types.size(); ++i)
+            links.push_back(make_link(types[i], "link_" + std::to_string(idx) + "_" + std::to_string(i), port + i));
+
+        //channels 0..servers-1 are taps after every server, last one is sink
+        channels.clear();
+        for(uint32_t i = 0; i != servers + 1; ++i)
+            channels.push_back(std::make_unique<channel>(cfg.messages));
+
+        std::list<importer_thread> importers;
+        std::list<makoa_process> processes;
+        importers.emplace_back(links.back().import, servers);
+        for(uint32_t i = 0; cfg.taps && i != servers; ++i)
+            importers.emplace_back("tyra " + std::to_string(port + 32 + i), i);
+
+        //servers started from sink side, so every exporter finds its consumer
+        for(uint32_t i = servers; i; --i) {
+            std::string name = "pipeline_" + std::to_string(idx) + "_" + std::to_string(i);
+            std::string conf = cfg.dir + "/" + name + ".conf";
+            std::vector<std::string> exports = {links[i].export_};
+            if(cfg.taps)
+                exports.push_back("tyra 127.0.0.1:" + std::to_string(port + 32 + i - 1));
+            write_conf(conf, name, links[i - 1].import, exports);
+            processes.emplace_front(conf);
+            usleep(cfg.startup_ms * 1000);
+            processes.front().check();
+        }
+
+        proceed_source(links[0].export_, can_run);
+
+        channel& sink = *channels.back();
+        uint64_t count = 0, progress = get_cur_ttime().value;
+        while(can_run && (count = sink.count) < cfg.messages) {
+            usleep(10000);
+            if(count != sink.count)
+                progress = get_cur_ttime().value;
+            else if(get_cur_ttime().value - progress > uint64_t(cfg.timeout) * ttime_t::frac)
+                break;
+        }
+
+        processes.clear();
+        importers.clear();
+
+        mlog ml;
+        ml << "topology " << topology << ", servers: " << servers << ", received " << count << " of " << cfg.messages;
+        if(sink.last != sink.first)
+            ml << ", throughput: " << uint64_t(double(count) * ttime_t::frac / (sink.last - sink.first)) << " msg/s";
+        uint64_t prev = 0;
+        for(uint32_t i = 0; i != channels.size(); ++i) {
+            channel& c = *channels[i];
+            if(i != servers && !cfg.taps)
+                continue;
+            percentiles p(c.latencies);
+            ml << "\n    " << (i == servers ? "sink" : "server " + std::to_string(i + 1)) << " (" << uint64_t(c.count) << "): " << p;
+            if(cfg.taps && i)
+                ml << ", hop p50: " << (int64_t(p.p50) - int64_t(prev)) / 1000 << "us";
+            prev = p.p50;
+        }
+    }
+
+    void proceed_pipeline(volatile bool& can_run)
+    {
+        const config& cfg = config::instance();
+        mkdir(cfg.dir.c_str(), 0777);
+        for(uint32_t i = 0; i != cfg.topologies.size() && can_run; ++i)
+            run_topology(cfg.topologies[i], i, can_run);
+    }
+}
+
+int main(int argc, char** argv)
+{
+    return parser_main(argc, argv, "pipeline_bench", proceed_pipeline);
+}
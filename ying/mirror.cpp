@@ -5,10 +5,10 @@
 #include "mirror.hpp"
 #include "ncurses.hpp"
 
+#include "makoa/tob.hpp"
+
 #include "evie/utils.hpp"
 
-#include <deque>
-#include <mutex>
 #include <thread>
 
 #include <unistd.h>
@@ -83,33 +83,49 @@ stream& operator<<(stream& s, print_dt v)
     return s;
 }
 
+//exporter thread publishes book to seqlocked slot and trades to ring,
+//refresh thread copies them without locks, so display never slows down exporter
 struct mirror::impl
 {
+    static const uint32_t depth = 100, trades_size = 256;
+
+    struct head : seqlock
+    {
+        message_instr mi;
+        int64_t dE, dP;
+    };
+
     security_filter sec;
     uint32_t refresh_rate;
-    
-    order_book ob;
-    std::deque<message_trade> trades;
-    message_instr mi;
-    std::string head_msg;
 
+    //exporter thread state
+    price_book ob;
+    ttime_t ob_time;
+    bool ob_changed;
+
+    tob_slot<depth> slot;
+    head hd;
+    //trade i stored in trades[i % trades_size] before trades_count released
+    message_trade trades[trades_size];
+    std::atomic<uint64_t> trades_count;
+
+    //refresh thread state, levels sorted by price
+    std::vector<tob_level> levels;
+    std::vector<message_trade> last_trades;
     price_t top_order_p;
     uint32_t trades_from;
 
     char buf[512];
     buf_stream bs;
- 
-    int64_t dE, dP;
-    
+
     volatile bool can_run;
-    std::mutex mutex;
     std::thread refresh_thrd;
 
     const char empty[10];
     impl(const std::string& sec, uint32_t refresh_rate_ms) :
-        sec(sec), refresh_rate(refresh_rate_ms * 1000),
+        sec(sec), refresh_rate(refresh_rate_ms * 1000), ob_time(), ob_changed(), slot(), hd(), trades(), trades_count(),
         top_order_p(), trades_from(), bs(buf, buf + sizeof(buf) - 1),
-        dE(), dP(), can_run(true), refresh_thrd(&impl::refresh_thread, this),
+        can_run(true), refresh_thrd(&impl::refresh_thread, this),
         empty("         ")
     {
     }
@@ -118,31 +134,52 @@ struct mirror::impl
         can_run = false;
         refresh_thrd.join();
     }
-    void set_instrument(const message_instr& i)
+    void read_book()
     {
-        mi = i;
-        head_msg = get_std_string(mi.exchange_id) + "/" + get_std_string(mi.feed_id) + "/" + get_std_string(mi.security);
+        tob_level l[2 * depth];
+        uint32_t bids = 0, asks = 0;
+        slot.read([&]() {
+            bids = slot.bids;
+            asks = slot.asks;
+            std::copy(slot.levels, slot.levels + depth * 2, l);
+        });
+        levels.clear();
+        for(uint32_t i = bids; i; --i)
+            levels.push_back(l[i - 1]);
+        levels.insert(levels.end(), l + depth, l + depth + asks);
     }
-    order_book::price_iterator get_top_order()
+    void read_trades(uint32_t rows)
     {
-        if(!top_order_p.value)
-            return ob.orders_p.begin();
-
-        auto it = ob.orders_p.lower_bound(top_order_p);
-        auto ib = ob.orders_p.begin(), ie = ob.orders_p.end();
-        while(it != ie && it != ib && !it->second.count.value)
-            --it;
-        if(it != ie)
-            top_order_p = it->first;
-        
-        return it;
+        for(;;) {
+            uint64_t c = trades_count.load(std::memory_order_acquire);
+            uint32_t n = std::min<uint64_t>(std::min(rows, trades_size / 2), c);
+            last_trades.resize(n);
+            for(uint32_t i = 0; i != n; ++i)
+                last_trades[i] = trades[(c - n + i) % trades_size];
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if(trades_count.load(std::memory_order_relaxed) - c + n <= trades_size)
+                return;
+        }
+    }
+    //first shown level, book centered on spread until scrolled
+    uint32_t get_top_order(uint32_t rows)
+    {
+        if(!top_order_p.value) {
+            uint32_t bids = 0;
+            while(bids != levels.size() && levels[bids].count.value > 0)
+                ++bids;
+            return bids > rows / 2 ? bids - rows / 2 : 0;
+        }
+        uint32_t i = 0;
+        while(i + 1 < levels.size() && levels[i].price < top_order_p)
+            ++i;
+        return i;
     }
     void print_trades(window& w)
     {
-        while(w.rows <= trades.size())
-            trades.pop_front();
+        read_trades(w.rows);
         uint32_t i = 0;
-        for(auto&& v : trades)
+        for(auto&& v : last_trades)
         {
             bs << brief_time(v.etime) << " " << brief_time(v.time) << " " << v.price << " " << v.count << " " << get_direction(v.direction) << '\0';
             e = mvwaddstr(w, i++, trades_from, bs.begin());
@@ -151,19 +188,12 @@ struct mirror::impl
     }
     void print_order_book(window& w)
     {
-        if(!sec.security_id)
-            return;
-        order_book::price_iterator it = get_top_order(), ie = ob.orders_p.end();
+        read_book();
         e = attron(A_BOLD);
-        for(uint32_t i = 0; i != w.rows - 1; ++i, ++it)
+        for(uint32_t i = 0, l = get_top_order(w.rows - 1); i != w.rows - 1 && l < levels.size(); ++i, ++l)
         {
-            while((it != ie) && !it->second.count.value)
-                ++it;
-            if(it == ie)
-                break;
-
-            e = attron(COLOR_PAIR(it->second.count.value < 0 ? 3 : 2));
-            bs << brief_time(it->second.time) << " " << it->first << " " << it->second.count;
+            e = attron(COLOR_PAIR(levels[l].count.value < 0 ? 3 : 2));
+            bs << levels[l].price << " " << levels[l].count;
             if(trades_from > bs.size() + 5)
                 bs.write(empty, trades_from - bs.size() - 5);
             bs << '\0';
@@ -176,20 +206,28 @@ struct mirror::impl
     }
     void print_head(window& w)
     {
+        message_instr mi = message_instr();
+        int64_t dE = 0, dP = 0;
+        hd.read([&]() {
+            mi = hd.mi;
+            dE = hd.dE;
+            dP = hd.dP;
+        });
         e = mvwaddnstr(w, w.rows - 1, 0, &w.blank_row[0], w.blank_row.size() - 1);
-        e = mvwaddstr(w, w.rows - 1, 0, head_msg.c_str());
+        if(mi.id == msg_instr) {
+            std::string head_msg = get_std_string(mi.exchange_id) + "/" + get_std_string(mi.feed_id) + "/" + get_std_string(mi.security);
+            e = mvwaddstr(w, w.rows - 1, 0, head_msg.c_str());
+        }
         bs << "dE: " << print_dt(dE) << ", dP: " << print_dt(dP) << '\0';
         e = mvwaddstr(w, w.rows - 1, w.cols - bs.size(), bs.begin());
         bs.clear();
     }
     void refresh(window& w)
     {
-        std::unique_lock<std::mutex> lock(mutex);
         w.clear();
         print_order_book(w);
         print_trades(w);
         print_head(w);
-        lock.unlock();
         move(w.rows - 1, 0);
         ::refresh();
     }
@@ -205,42 +243,14 @@ struct mirror::impl
             else
             {
                 //mlog() << "key: " << key;
+                if(levels.empty())
+                    break;
+                uint32_t l = get_top_order(w.rows - 1);
                 if(key == 259 || key == 339) // arrow up and page up
-                {
-                    uint32_t r = (key == 259 ? 1 : w.rows);
-                    std::unique_lock<std::mutex> lock(mutex);
-                    order_book::price_iterator it = get_top_order(), ib = ob.orders_p.begin();
-
-                    for(uint32_t i = 0; i != r; ++i) {
-                        if(it != ib) {
-                            --it;
-                            while(it != ib && !it->second.count.value)
-                                --it;
-                        }
-                    }
-                    top_order_p = it->first;
-                }
+                    l -= std::min(l, key == 259 ? 1 : w.rows);
                 else if(key == 258 || key == 338) //arrow down or page down
-                {
-                    std::unique_lock<std::mutex> lock(mutex);
-                    order_book::price_iterator it = ob.orders_p.upper_bound(top_order_p), ie = ob.orders_p.end();
-                    auto ib = it;
-                    while(it != ie && !it->second.count.value)
-                        ++it;
-                    uint32_t r = (key == 258 ? 0 : w.rows - 1);
-                    for(uint32_t i = 0; i != r; ++i) {
-                        if(it != ie) {
-                            ++it;
-                            while(it != ie && !it->second.count.value)
-                                ++it;
-                        }
-                    }
-                    if(it == ie && ib != ie)
-                        --it;
-
-                    if(it != ie)
-                        top_order_p = it->first;
-                }
+                    l = std::min<uint32_t>(levels.size() - 1, l + (key == 258 ? 1 : w.rows - 1));
+                top_order_p = levels[l].price;
                 break;
             }
         }
@@ -269,26 +279,38 @@ struct mirror::impl
         if(m.id == msg_ping)
             return;
         if(sec.equal(m)) {
-            std::unique_lock<std::mutex> lock(mutex);
-            if(m.id == msg_instr)
-                set_instrument(m.mi);
             if(m.id == msg_trade) {
-                trades.push_back(m.mt);
+                uint64_t c = trades_count.load(std::memory_order_relaxed);
+                trades[c % trades_size] = m.mt;
+                trades_count.store(c + 1, std::memory_order_release);
                 ttime_t ct = get_cur_ttime();
-                dE = ct - m.mt.etime;
-                dP = ct - m.mt.time;
+                hd.write([&]() {
+                    hd.dE = ct - m.mt.etime;
+                    hd.dP = ct - m.mt.time;
+                });
+                return;
+            }
+            if(m.id == msg_book) {
+                ob.set(m.mb);
+                hd.write([&]() {hd.dP = get_cur_ttime() - m.mb.time;});
             }
             else {
-                ob.proceed(m);
-                if(m.id == msg_book)
-                    dP = get_cur_ttime() - m.mb.time;
+                ob.clear();
+                if(m.id == msg_instr)
+                    hd.write([&]() {hd.mi = m.mi;});
             }
+            ob_time = m.t.time;
+            ob_changed = true;
         }
     }
     void proceed(const message* m, uint32_t count)
     {
         for(uint32_t i = 0; i != count; ++i, ++m)
             proceed(*m);
+        if(ob_changed) {
+            slot.publish(ob, ob_time);
+            ob_changed = false;
+        }
     }
 };
 